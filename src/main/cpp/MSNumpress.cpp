@@ -20,8 +20,20 @@
 #include <iostream>
 #include <cmath>
 #include <climits>
+#include <cfloat>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
 #include "MSNumpress.hpp"
 
+#if defined(__F16C__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifdef MSNUMPRESS_USDT
+#include <sys/sdt.h>
+#endif
+
 namespace ms {
 namespace numpress {
 namespace MSNumpress {
@@ -72,6 +84,137 @@ static double decodeFixedPoint(
 	return fixedPoint;
 }
 
+
+
+static void encodeUInt32(
+		size_t x,
+		unsigned char *result
+) {
+	int i;
+	for (i=0; i<4; i++) {
+		result[i] = static_cast<unsigned char>((x >> (i*8)) & 0xff);
+	}
+}
+
+
+
+static size_t decodeUInt32(
+		const unsigned char *data
+) {
+	int i;
+	size_t x = 0;
+	for (i=0; i<4; i++) {
+		x = x | (static_cast<size_t>(data[i]) << (i*8));
+	}
+	return x;
+}
+
+
+
+/////////////////////////////////////////////////////////////
+
+/*
+	USDT probes, compiled in with -DMSNUMPRESS_USDT (needs sys/sdt.h, e.g. 
+	from systemtap-sdt-dev). The array encode and decode functions then fire
+	
+		msnumpress:encode_entry 	(codec, values, 0, fixedPoint)
+		msnumpress:encode_return 	(codec, values, bytes, fixedPoint)
+		msnumpress:decode_entry 	(codec, 0, bytes, fixedPoint)
+		msnumpress:decode_return 	(codec, values, bytes, fixedPoint)
+	
+	with codec a ProbeCodec and fixedPoint rounded to an integer, or 0 for 
+	codecs without one. Return probes do not fire when an exception is thrown.
+	Codecs built on others (PicSqrt, Calibrated, Spectrum) only fire their own
+	probes, so every call is counted once.
+	A probe without an attached tracer costs a nop, e.g. for
+	
+		bpftrace -e 'usdt:./test:msnumpress:decode_return { @[arg0] = hist(arg1); }'
+ */
+
+enum ProbeCodec {
+	PROBE_LINEAR 		= BLOCK_LINEAR,
+	PROBE_PIC 			= BLOCK_PIC,
+	PROBE_SLOF 			= BLOCK_SLOF,
+	PROBE_LINEAR_RUNS 	= 3,
+	PROBE_SAFE 			= 4,
+	PROBE_SAFE_SHUFFLED = 5,
+	PROBE_PIC_SQRT 		= 6,
+	PROBE_SLOF_FAST 	= 7,
+	PROBE_SLOF_LOG 		= 8,
+	PROBE_SLOF_HALF 	= 9,
+	PROBE_SLOF_SHUFFLED = 10,
+	PROBE_SLOF_LINEAR 	= 11,
+	PROBE_STEP 			= 12,
+	PROBE_CALIBRATED 	= 13,
+	PROBE_SPECTRUM 		= 15
+};
+
+#ifdef MSNUMPRESS_USDT
+
+static long long probeFixedPoint(
+		double fixedPoint
+) {
+	return static_cast<long long>(floor(fixedPoint + 0.5));
+}
+
+
+
+/**
+ * The fixed point in the first 8 bytes of data, if header, otherwise 0.
+ */
+static long long probeHeaderFixedPoint(
+		const unsigned char *data,
+		size_t dataSize,
+		bool header
+) {
+	return header && dataSize >= 8 ? probeFixedPoint(decodeFixedPoint(data)) : 0;
+}
+
+
+
+static size_t probeEncodeReturn(
+		int codec,
+		size_t values,
+		size_t bytes,
+		double fixedPoint
+) {
+	DTRACE_PROBE4(msnumpress, encode_return, codec, values, bytes, probeFixedPoint(fixedPoint));
+	return bytes;
+}
+
+
+
+static size_t probeDecodeReturn(
+		int codec,
+		size_t values,
+		const unsigned char *data,
+		size_t dataSize,
+		bool header
+) {
+	DTRACE_PROBE4(msnumpress, decode_return, codec, values, dataSize, probeHeaderFixedPoint(data, dataSize, header));
+	return values;
+}
+
+#define PROBE_ENCODE_ENTRY(codec, values, fixedPoint) \
+	DTRACE_PROBE4(msnumpress, encode_entry, codec, values, 0, probeFixedPoint(fixedPoint))
+#define PROBE_ENCODE_RETURN(codec, values, bytes, fixedPoint) \
+	probeEncodeReturn(codec, values, bytes, fixedPoint)
+#define PROBE_DECODE_ENTRY(codec, data, dataSize, header) \
+	DTRACE_PROBE4(msnumpress, decode_entry, codec, 0, dataSize, probeHeaderFixedPoint(data, dataSize, header))
+#define PROBE_DECODE_RETURN(codec, values, data, dataSize, header) \
+	probeDecodeReturn(codec, values, data, dataSize, header)
+
+#else
+
+#define PROBE_ENCODE_ENTRY(codec, values, fixedPoint) ((void)0)
+#define PROBE_ENCODE_RETURN(codec, values, bytes, fixedPoint) (bytes)
+#define PROBE_DECODE_ENTRY(codec, data, dataSize, header) ((void)0)
+#define PROBE_DECODE_RETURN(codec, values, data, dataSize, header) (values)
+
+#endif
+
+
+
 /////////////////////////////////////////////////////////////
 
 /**
@@ -231,40 +374,87 @@ double optimalLinearFixedPoint(
 
 
 
-size_t encodeLinear(
+double optimalLinearRunsFixedPoint(
+		const double *data, 
+		size_t dataSize
+) {
+	double fp = optimalLinearFixedPoint(data, dataSize);
+	if (fp < 1) return fp;
+	return pow(10, floor(log10(fp)));
+}
+
+
+
+/**
+ * Shortest run of zero residuals that encodeLinearRuns replaces with a run
+ * token. A token takes 9 halfbytes, while each zero residual takes 1.
+ */
+static const size_t LINEAR_RUN_MIN = 10;
+
+/**
+ * Longest run a single token can hold, as the most significant halfbyte
+ * of the count must stay 0x0 to tell tokens apart from encodeInt output.
+ */
+static const size_t LINEAR_RUN_MAX = 0x0FFFFFFF;
+
+/**
+ * Stores a run token for count zero residuals as 9 halfbytes in res.
+ * res_length is incremented by 9.
+ */
+static void encodeRunToken(
+		const unsigned int count,
+		unsigned char* res,
+		size_t *res_length
+) {
+	unsigned char i;
+
+	res[0] = 0;
+	for (i=0; i<8; i++) {
+		res[1+i] = static_cast<unsigned char>( count >> (4*i) );
+	}
+	*res_length += 9;
+}
+
+
+
+/**
+ * Encodes data as encodeLinear or encodeLinearRuns, but without the leading
+ * fixed point, as the sections of a spectrum block.
+ */
+static size_t encodeLinearValues(
 		const double *data, 
 		size_t dataSize, 
 		unsigned char *result,
-		double fixedPoint
+		double fixedPoint,
+		bool encodeRuns
 ) {
 	long long ints[3];
-	size_t i, ri;
+	size_t i, j, ri;
 	unsigned char halfBytes[10];
 	size_t halfByteCount;
 	size_t hbi;
 	long long extrapol;
+	long long runInts[3];
 	int diff;
 
 	//printf("Encoding %d doubles with fixed point %f\n", (int)dataSize, fixedPoint);
-	encodeFixedPoint(fixedPoint, result);
 
-
-	if (dataSize == 0) return 8;
+	if (dataSize == 0) return 0;
 
 	ints[1] = static_cast<long long>(data[0] * fixedPoint + 0.5);
 	for (i=0; i<4; i++) {
-		result[8+i] = (ints[1] >> (i*8)) & 0xff;
+		result[i] = (ints[1] >> (i*8)) & 0xff;
 	}
 
-	if (dataSize == 1) return 12;
+	if (dataSize == 1) return 4;
 
 	ints[2] = static_cast<long long>(data[1] * fixedPoint + 0.5);
 	for (i=0; i<4; i++) {
-		result[12+i] = (ints[2] >> (i*8)) & 0xff;
+		result[4+i] = (ints[2] >> (i*8)) & 0xff;
 	}
 
 	halfByteCount = 0;
-	ri = 16;
+	ri = 8;
 
 	for (i=2; i<dataSize; i++) {
 		ints[0] = ints[1];
@@ -284,12 +474,39 @@ size_t encodeLinear(
 		}
 
 		diff = static_cast<int>(ints[2] - extrapol);
-		//printf("%lu %lu %lu,   extrapol: %ld    diff: %d \n", ints[0], ints[1], ints[2], extrapol, diff);
-		encodeInt(
-				static_cast<unsigned int>(diff), 
-				&halfBytes[halfByteCount], 
-				&halfByteCount
-			);
+
+		if (encodeRuns && diff == 0) {
+			// look ahead for more values on the same arithmetic progression
+			runInts[0] = ints[1];
+			runInts[1] = ints[2];
+			for (j=i+1; j<dataSize && j-i < LINEAR_RUN_MAX; j++) {
+				if (data[j] * fixedPoint + 0.5 > LLONG_MAX) break;
+				runInts[2] = static_cast<long long>(data[j] * fixedPoint + 0.5);
+				if (runInts[2] - runInts[1] != runInts[1] - runInts[0]) break;
+				runInts[0] = runInts[1];
+				runInts[1] = runInts[2];
+			}
+			
+			if (j - i >= LINEAR_RUN_MIN) {
+				encodeRunToken(
+						static_cast<unsigned int>(j - i),
+						&halfBytes[halfByteCount],
+						&halfByteCount
+					);
+				ints[1] = runInts[0];
+				ints[2] = runInts[1];
+				i = j - 1;
+			} else {
+				encodeInt(0, &halfBytes[halfByteCount], &halfByteCount);
+			}
+		} else {
+			//printf("%lu %lu %lu,   extrapol: %ld    diff: %d \n", ints[0], ints[1], ints[2], extrapol, diff);
+			encodeInt(
+					static_cast<unsigned int>(diff), 
+					&halfBytes[halfByteCount], 
+					&halfByteCount
+				);
+		}
 		/*
 		printf("%d (%d):  ", diff, (int)halfByteCount);
 		for (size_t j=0; j<halfByteCount; j++) {
@@ -322,10 +539,56 @@ size_t encodeLinear(
 
 
 
-size_t decodeLinear(
+static size_t encodeLinearImpl(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint,
+		bool encodeRuns
+) {
+	encodeFixedPoint(fixedPoint, result);
+	return 8 + encodeLinearValues(data, dataSize, &result[8], fixedPoint, encodeRuns);
+}
+
+
+
+size_t encodeLinear(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_LINEAR, dataSize, fixedPoint);
+	return PROBE_ENCODE_RETURN(PROBE_LINEAR, dataSize, encodeLinearImpl(data, dataSize, result, fixedPoint, false), fixedPoint);
+}
+
+
+
+size_t encodeLinearRuns(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_LINEAR_RUNS, dataSize, fixedPoint);
+	return PROBE_ENCODE_RETURN(PROBE_LINEAR_RUNS, dataSize, encodeLinearImpl(data, dataSize, result, fixedPoint, true), fixedPoint);
+}
+
+
+
+/**
+ * Decodes data encoded by encodeLinearValues with fixedPoint, throwing 
+ * instead of writing more than maxResult doubles. If bytesRead is not NULL,
+ * decoding stops after maxResult doubles, as for a section followed by 
+ * another one, and the number of bytes they took is stored in *bytesRead.
+ */
+static size_t decodeLinearValues(
 		const unsigned char *data,
 		const size_t dataSize,
-		double *result
+		double fixedPoint,
+		double *result,
+		size_t maxResult,
+		size_t *bytesRead = NULL
 ) {
 	size_t i;
 	size_t ri = 0;
@@ -337,40 +600,40 @@ size_t decodeLinear(
 	size_t half;
 	long long extrapol;
 	long long y;
-	double fixedPoint;
 	
 	//printf("Decoding %d bytes with fixed point %f\n", (int)dataSize, fixedPoint);
 
-	if (dataSize == 8) return 0;
-
-	if (dataSize < 8) 
-		throw "[MSNumpress::decodeLinear] Corrupt input data: not enough bytes to read fixed point! ";
-	
-	fixedPoint = decodeFixedPoint(data);
-
+	if (bytesRead != NULL) *bytesRead = 0;
+	if (dataSize == 0 || (bytesRead != NULL && maxResult == 0)) return 0;
 
-	if (dataSize < 12) 
+	if (dataSize < 4) 
 		throw "[MSNumpress::decodeLinear] Corrupt input data: not enough bytes to read first value! ";
 
+	if (maxResult < 1) 
+		throw "[MSNumpress::decodeLinear] Corrupt input data: more values than expected! ";
+
 	ints[1] = 0;
 	for (i=0; i<4; i++) {
-		ints[1] = ints[1] | ((0xff & (init = data[8+i])) << (i*8));
+		ints[1] = ints[1] | ((0xff & (init = data[i])) << (i*8));
 	}
 	result[0] = ints[1] / fixedPoint;
 
-	if (dataSize == 12) return 1;
-	if (dataSize < 16) 
+	if (bytesRead != NULL) *bytesRead = 4;
+	if (dataSize == 4 || (bytesRead != NULL && maxResult == 1)) return 1;
+	if (dataSize < 8) 
 		throw "[MSNumpress::decodeLinear] Corrupt input data: not enough bytes to read second value! ";
+	if (maxResult < 2) 
+		throw "[MSNumpress::decodeLinear] Corrupt input data: more values than expected! ";
 
 	ints[2] = 0;
 	for (i=0; i<4; i++) {
-		ints[2] = ints[2] | ((0xff & (init = data[12+i])) << (i*8));
+		ints[2] = ints[2] | ((0xff & (init = data[4+i])) << (i*8));
 	}
 	result[1] = ints[2] / fixedPoint;
 		
 	half = 0;
 	ri = 2;
-	di = 16;
+	di = 8;
 	
 	//printf("   di     ri      half    int[0]    int[1]    extrapol   diff\n");
 	
@@ -381,6 +644,10 @@ size_t decodeLinear(
 			}
 		}
 		//printf("%7d %7d %7d %lu %lu %ld", di, ri, half, ints[0], ints[1], extrapol);
+		if (ri >= maxResult) {
+			if (bytesRead != NULL) break;
+			throw "[MSNumpress::decodeLinear] Corrupt input data: more values than expected! ";
+		}
 		
 		ints[0] = ints[1];
 		ints[1] = ints[2];
@@ -394,11 +661,41 @@ size_t decodeLinear(
 		ints[2] 		= y;
 	}
 
+	if (bytesRead != NULL) *bytesRead = di + half;
 	return ri;
 }
 
 
 
+/**
+ * Shared implementation of decodeLinear and decodeCalibrated, which throws
+ * instead of writing more than maxResult doubles.
+ */
+static size_t decodeLinearImpl(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result,
+		size_t maxResult
+) {
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeLinear] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	return decodeLinearValues(&data[8], dataSize - 8, decodeFixedPoint(data), result, maxResult);
+}
+
+
+
+size_t decodeLinear(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_LINEAR, data, dataSize, true);
+	return PROBE_DECODE_RETURN(PROBE_LINEAR, decodeLinearImpl(data, dataSize, result, static_cast<size_t>(-1)), data, dataSize, true);
+}
+
+
+
 void encodeLinear(
 		const std::vector<double> &data, 
 		std::vector<unsigned char> &result,
@@ -422,92 +719,324 @@ void decodeLinear(
 	result.resize(decodedLength);
 }
 
-/////////////////////////////////////////////////////////////
-
+/**
+ * Largest magnitude of the ints decodeLinearRuns accepts, so that neither the
+ * linear prediction nor a run can overflow a long long.
+ */
+static const long long LINEAR_RUNS_MAX_INT = 1LL << 60;
 
-size_t encodeSafe(
-		const double *data, 
-		const size_t dataSize, 
-		unsigned char *result
+/**
+ * Writes the count values following y along the arithmetic progression 
+ * y + step, y + 2*step, ... divided by fixedPoint into result. The caller
+ * checks that the progression stays within LINEAR_RUNS_MAX_INT.
+ */
+static void fillLinearRun(
+		long long y,
+		long long step,
+		size_t count,
+		double fixedPoint,
+		double *result
 ) {
-	size_t i, j, ri = 0;
-	double latest[3];
-	double extrapol, diff;
-	const unsigned char *fp; 
-	
-	//printf("d0 d1 d2 extrapol diff\n");
-		
-	if (dataSize == 0) return ri;
-
-	latest[1] = data[0];
-	fp = (unsigned char*)data;
-	for (i=0; i<8; i++) {
-		result[ri++] = fp[IS_BIG_ENDIAN ? (7-i) : i];
-	}
+	size_t i;
+	int j;
+	long long last = y + step * static_cast<long long>(count);
 	
-	if (dataSize == 1) return ri;
-
-	latest[2] = data[1];
-	fp = (unsigned char*)&(data[1]);
-	for (i=0; i<8; i++) {
-		result[ri++] = fp[IS_BIG_ENDIAN ? (7-i) : i];
-	}
-
-	fp = (unsigned char*)&diff;
-	for (i=2; i<dataSize; i++) {
-		latest[0] = latest[1];
-		latest[1] = latest[2];
-		latest[2] = data[i];
-		extrapol = latest[1] + (latest[1] - latest[0]);
-		diff = latest[2] - extrapol;
-		//printf("%f %f %f %f %f\n", latest[0], latest[1], latest[2], extrapol, diff);
-		for (j=0; j<8; j++) {
-			result[ri++] = fp[IS_BIG_ENDIAN ? (7-j) : j];
+	if (llabs(y) < (1LL << 52) && llabs(last) < (1LL << 52)) {
+		// all terms are exact in double, so this matches y / fixedPoint
+		// bit for bit, while vectorizing well
+		double base = static_cast<double>(y);
+		double dstep = static_cast<double>(step);
+		int n = static_cast<int>(count);
+		for (j=0; j<n; j++) {
+			result[j] = (base + dstep * (j+1)) / fixedPoint;
+		}
+	} else {
+		for (i=0; i<count; i++) {
+			y += step;
+			result[i] = y / fixedPoint;
 		}
 	}
-	
-	return ri;
 }
 
 
 
-size_t decodeSafe(
+/**
+ * Decodes data encoded by encodeLinearValues with runs and fixedPoint, 
+ * throwing instead of writing more than maxResult doubles.
+ * If result is NULL, values are only counted. If grow is not NULL, result
+ * and maxResult are ignored, and values are written to *grow, which is 
+ * enlarged as needed.
+ */
+static size_t decodeLinearRunsValues(
 		const unsigned char *data,
 		const size_t dataSize,
-		double *result
+		double fixedPoint,
+		double *result,
+		size_t maxResult,
+		std::vector<double> *grow = NULL
 ) {
-	size_t i, di, ri;
-	double extrapol, diff;
-	double latest[3];
-	unsigned char *fp;
-	
-	if (dataSize % 8 != 0) 
-		throw "[MSNumpress::decodeSafe] Corrupt input data: number of bytes needs to be multiple of 8! ";
-	
-	//printf("d0 d1 extrapol diff\td2\n");
+	size_t i;
+	size_t ri = 0;
+	unsigned int init, buff;
+	int diff;
+	long long ints[3];
+	size_t di;
+	size_t half;
+	unsigned char head;
+	long long extrapol;
+	long long y, step;
 	
-	try {
-		fp = (unsigned char*)&(latest[1]);
-		for (i=0; i<8; i++) {
-			fp[i] = data[IS_BIG_ENDIAN ? (7-i) : i];
-		}
-		result[0] = latest[1];
+	if (grow != NULL) {
+		grow->resize(max(grow->size(), static_cast<size_t>(2)));
+		result = &(*grow)[0];
+		maxResult = grow->size();
+	}
 
-		if (dataSize == 8) return 1;
+	if (dataSize == 0) return 0;
 
-		fp = (unsigned char*)&(latest[2]);
-		for (i=0; i<8; i++) {
-			fp[i] = data[8 + (IS_BIG_ENDIAN ? (7-i) : i)];
-		}
-		result[1] = latest[2];
-		
-		ri = 2;
-		
-		fp = (unsigned char*)&diff;
-		for (di = 16; di < dataSize; di += 8) {
-			latest[0] = latest[1];
-			latest[1] = latest[2];
-			
+	if (dataSize < 4) 
+		throw "[MSNumpress::decodeLinearRuns] Corrupt input data: not enough bytes to read first value! ";
+
+	if (maxResult < 1) 
+		throw "[MSNumpress::decodeLinearRuns] Corrupt input data: more values than expected! ";
+
+	ints[1] = 0;
+	for (i=0; i<4; i++) {
+		ints[1] = ints[1] | ((0xff & (init = data[i])) << (i*8));
+	}
+	if (result != NULL) result[0] = ints[1] / fixedPoint;
+
+	if (dataSize == 4) return 1;
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeLinearRuns] Corrupt input data: not enough bytes to read second value! ";
+	if (maxResult < 2) 
+		throw "[MSNumpress::decodeLinearRuns] Corrupt input data: more values than expected! ";
+
+	ints[2] = 0;
+	for (i=0; i<4; i++) {
+		ints[2] = ints[2] | ((0xff & (init = data[4+i])) << (i*8));
+	}
+	if (result != NULL) result[1] = ints[2] / fixedPoint;
+		
+	half = 0;
+	ri = 2;
+	di = 8;
+	
+	while (di < dataSize) {
+		if (di == (dataSize - 1) && half == 1) {
+			if ((data[di] & 0xf) == 0x0) {
+				break;
+			}
+		}
+		
+		head = (half == 0) ? (data[di] >> 4) : (data[di] & 0xf);
+		decodeInt(data, &di, dataSize, &half, &buff);
+
+		if (head == 0 && (buff & 0xf0000000) == 0) {
+			// run token, buff more values on the current progression
+			if (buff == 0)
+				throw "[MSNumpress::decodeLinearRuns] Corrupt input data: empty run! ";
+			if (buff > maxResult - ri) {
+				if (grow == NULL)
+					throw "[MSNumpress::decodeLinearRuns] Corrupt input data: more values than expected! ";
+				grow->resize(max(ri + buff, 2 * grow->size()));
+				result = &(*grow)[0];
+				maxResult = grow->size();
+			}
+			// |step| <= 2^61, and the product cannot overflow once checked
+			step = ints[2] - ints[1];
+			if (llabs(step) > 2 * LINEAR_RUNS_MAX_INT / static_cast<long long>(buff))
+				throw "[MSNumpress::decodeLinearRuns] Corrupt input data: run out of range! ";
+			y = ints[2] + step * static_cast<long long>(buff);
+			if (llabs(y) > LINEAR_RUNS_MAX_INT)
+				throw "[MSNumpress::decodeLinearRuns] Corrupt input data: run out of range! ";
+			if (result != NULL) {
+				fillLinearRun(ints[2], step, buff, fixedPoint, &result[ri]);
+			}
+			ri += buff;
+			ints[1] = y - step;
+			ints[2] = y;
+			continue;
+		}
+		if (ri >= maxResult) {
+			if (grow == NULL)
+				throw "[MSNumpress::decodeLinearRuns] Corrupt input data: more values than expected! ";
+			grow->resize(2 * grow->size());
+			result = &(*grow)[0];
+			maxResult = grow->size();
+		}
+		
+		ints[0] = ints[1];
+		ints[1] = ints[2];
+		diff = static_cast<int>(buff);
+
+		extrapol = ints[1] + (ints[1] - ints[0]);
+		y = extrapol + diff;
+		if (llabs(y) > LINEAR_RUNS_MAX_INT)
+			throw "[MSNumpress::decodeLinearRuns] Corrupt input data: value out of range! ";
+		if (result != NULL) result[ri] = y / fixedPoint;
+		ri++;
+		ints[2] 		= y;
+	}
+
+	return ri;
+}
+
+
+
+/**
+ * Shared implementation of decodeLinearRuns and decodeLinearRunsLength,
+ * which throws instead of writing more than maxResult doubles.
+ * If result is NULL, values are only counted.
+ */
+static size_t decodeLinearRunsImpl(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result,
+		size_t maxResult,
+		std::vector<double> *grow = NULL
+) {
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeLinearRuns] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	return decodeLinearRunsValues(&data[8], dataSize - 8, decodeFixedPoint(data), result, maxResult, grow);
+}
+
+
+
+size_t decodeLinearRunsLength(
+		const unsigned char *data,
+		const size_t dataSize
+) {
+	return decodeLinearRunsImpl(data, dataSize, NULL, static_cast<size_t>(-1));
+}
+
+
+
+size_t decodeLinearRuns(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_LINEAR_RUNS, data, dataSize, true);
+	return PROBE_DECODE_RETURN(PROBE_LINEAR_RUNS, decodeLinearRunsImpl(data, dataSize, result, static_cast<size_t>(-1)), data, dataSize, true);
+}
+
+
+
+void encodeLinearRuns(
+		const std::vector<double> &data, 
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 5 + 8);
+	size_t encodedLength = encodeLinearRuns(&data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeLinearRuns(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	PROBE_DECODE_ENTRY(PROBE_LINEAR_RUNS, &data[0], dataSize, true);
+	// in one pass, from the bound without run tokens, grown only for runs
+	result.resize(dataSize <= 16 ? 2 : 2 + (dataSize - 16) * 2);
+	size_t decodedLength = decodeLinearRunsImpl(&data[0], dataSize, NULL, 0, &result);
+	result.resize(PROBE_DECODE_RETURN(PROBE_LINEAR_RUNS, decodedLength, &data[0], dataSize, true));
+}
+
+/////////////////////////////////////////////////////////////
+
+
+size_t encodeSafe(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SAFE, dataSize, 0);
+	size_t i, j, ri = 0;
+	double latest[3];
+	double extrapol, diff;
+	const unsigned char *fp; 
+	
+	//printf("d0 d1 d2 extrapol diff\n");
+		
+	if (dataSize == 0) return PROBE_ENCODE_RETURN(PROBE_SAFE, dataSize, ri, 0);
+
+	latest[1] = data[0];
+	fp = (unsigned char*)data;
+	for (i=0; i<8; i++) {
+		result[ri++] = fp[IS_BIG_ENDIAN ? (7-i) : i];
+	}
+	
+	if (dataSize == 1) return PROBE_ENCODE_RETURN(PROBE_SAFE, dataSize, ri, 0);
+
+	latest[2] = data[1];
+	fp = (unsigned char*)&(data[1]);
+	for (i=0; i<8; i++) {
+		result[ri++] = fp[IS_BIG_ENDIAN ? (7-i) : i];
+	}
+
+	fp = (unsigned char*)&diff;
+	for (i=2; i<dataSize; i++) {
+		latest[0] = latest[1];
+		latest[1] = latest[2];
+		latest[2] = data[i];
+		extrapol = latest[1] + (latest[1] - latest[0]);
+		diff = latest[2] - extrapol;
+		//printf("%f %f %f %f %f\n", latest[0], latest[1], latest[2], extrapol, diff);
+		for (j=0; j<8; j++) {
+			result[ri++] = fp[IS_BIG_ENDIAN ? (7-j) : j];
+		}
+	}
+	
+	return PROBE_ENCODE_RETURN(PROBE_SAFE, dataSize, ri, 0);
+}
+
+
+
+size_t decodeSafe(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SAFE, data, dataSize, false);
+	size_t i, di, ri;
+	double extrapol, diff;
+	double latest[3];
+	unsigned char *fp;
+	
+	if (dataSize % 8 != 0) 
+		throw "[MSNumpress::decodeSafe] Corrupt input data: number of bytes needs to be multiple of 8! ";
+	
+	//printf("d0 d1 extrapol diff\td2\n");
+	
+	try {
+		fp = (unsigned char*)&(latest[1]);
+		for (i=0; i<8; i++) {
+			fp[i] = data[IS_BIG_ENDIAN ? (7-i) : i];
+		}
+		result[0] = latest[1];
+
+		if (dataSize == 8) return PROBE_DECODE_RETURN(PROBE_SAFE, 1, data, dataSize, false);
+
+		fp = (unsigned char*)&(latest[2]);
+		for (i=0; i<8; i++) {
+			fp[i] = data[8 + (IS_BIG_ENDIAN ? (7-i) : i)];
+		}
+		result[1] = latest[2];
+		
+		ri = 2;
+		
+		fp = (unsigned char*)&diff;
+		for (di = 16; di < dataSize; di += 8) {
+			latest[0] = latest[1];
+			latest[1] = latest[2];
+			
 			for (i=0; i<8; i++) {
 				fp[i] = data[di + (IS_BIG_ENDIAN ? (7-i) : i)];
 			}
@@ -519,226 +1048,2454 @@ size_t decodeSafe(
 		
 			result[ri++] = latest[2];
 		}
-	} catch (...) {
-		throw "[MSNumpress::decodeSafe] Unknown error during decode! ";
+	} catch (...) {
+		throw "[MSNumpress::decodeSafe] Unknown error during decode! ";
+	}
+	
+	return PROBE_DECODE_RETURN(PROBE_SAFE, ri, data, dataSize, false);
+}
+
+/**
+ * Transposes count elements of 8 bytes at in into 8 planes at out,
+ * planeStride bytes apart.
+ */
+static void shuffle8(
+		const unsigned char *in,
+		size_t count,
+		unsigned char *out,
+		size_t planeStride
+) {
+	size_t i = 0;
+	size_t j;
+#ifdef __SSE2__
+	int p, q;
+	__m128i x[8], lo[4], hi[4], u[2][4], t0, t1;
+	
+	for (; i+16<=count; i+=16) {
+		for (p=0; p<8; p++) {
+			x[p] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[(i + 2*p) * 8]));
+		}
+		// bytes 0-3 and 4-7 of elements 4p to 4p+3, grouped by byte
+		for (p=0; p<4; p++) {
+			t0 = _mm_unpacklo_epi8(x[2*p], x[2*p+1]);
+			t1 = _mm_unpackhi_epi8(x[2*p], x[2*p+1]);
+			lo[p] = _mm_unpacklo_epi8(t0, t1);
+			hi[p] = _mm_unpackhi_epi8(t0, t1);
+		}
+		// two bytes each of elements 8q to 8q+7
+		for (q=0; q<2; q++) {
+			u[q][0] = _mm_unpacklo_epi32(lo[2*q], lo[2*q+1]);
+			u[q][1] = _mm_unpackhi_epi32(lo[2*q], lo[2*q+1]);
+			u[q][2] = _mm_unpacklo_epi32(hi[2*q], hi[2*q+1]);
+			u[q][3] = _mm_unpackhi_epi32(hi[2*q], hi[2*q+1]);
+		}
+		for (p=0; p<4; p++) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(2*p) * planeStride + i]), 
+					_mm_unpacklo_epi64(u[0][p], u[1][p]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(2*p+1) * planeStride + i]), 
+					_mm_unpackhi_epi64(u[0][p], u[1][p]));
+		}
+	}
+#endif
+	for (; i<count; i++) {
+		for (j=0; j<8; j++) {
+			out[j * planeStride + i] = in[i * 8 + j];
+		}
+	}
+}
+
+
+
+/**
+ * Reverses shuffle8.
+ */
+static void unshuffle8(
+		const unsigned char *in,
+		size_t count,
+		size_t planeStride,
+		unsigned char *out
+) {
+	size_t i = 0;
+	size_t j;
+#ifdef __SSE2__
+	int p;
+	__m128i x[8], a[8], b[4];
+	
+	for (; i+16<=count; i+=16) {
+		for (p=0; p<8; p++) {
+			x[p] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[p * planeStride + i]));
+		}
+		// byte pairs 2p, 2p+1 of elements 0-7 and 8-15
+		for (p=0; p<4; p++) {
+			a[2*p] 		= _mm_unpacklo_epi8(x[2*p], x[2*p+1]);
+			a[2*p+1] 	= _mm_unpackhi_epi8(x[2*p], x[2*p+1]);
+		}
+		// bytes 0-3 and 4-7 of elements 8p to 8p+7, then whole elements
+		for (p=0; p<2; p++) {
+			b[0] = _mm_unpacklo_epi16(a[p], a[2+p]);
+			b[1] = _mm_unpackhi_epi16(a[p], a[2+p]);
+			b[2] = _mm_unpacklo_epi16(a[4+p], a[6+p]);
+			b[3] = _mm_unpackhi_epi16(a[4+p], a[6+p]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(i + 8*p) * 8]), 
+					_mm_unpacklo_epi32(b[0], b[2]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(i + 8*p + 2) * 8]), 
+					_mm_unpackhi_epi32(b[0], b[2]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(i + 8*p + 4) * 8]), 
+					_mm_unpacklo_epi32(b[1], b[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[(i + 8*p + 6) * 8]), 
+					_mm_unpackhi_epi32(b[1], b[3]));
+		}
+	}
+#endif
+	for (; i<count; i++) {
+		for (j=0; j<8; j++) {
+			out[i * 8 + j] = in[j * planeStride + i];
+		}
+	}
+}
+
+
+
+void shuffleBytes(
+		const unsigned char *data,
+		const size_t dataSize,
+		const size_t elementSize,
+		unsigned char *result
+) {
+	size_t i, j;
+	
+	if (elementSize == 8) {
+		shuffle8(data, dataSize, result, dataSize);
+		return;
+	}
+	for (i=0; i<dataSize; i++) {
+		for (j=0; j<elementSize; j++) {
+			result[j * dataSize + i] = data[i * elementSize + j];
+		}
+	}
+}
+
+
+
+void unshuffleBytes(
+		const unsigned char *data,
+		const size_t dataSize,
+		const size_t elementSize,
+		unsigned char *result
+) {
+	size_t i, j;
+	
+	if (elementSize == 8) {
+		unshuffle8(data, dataSize, dataSize, result);
+		return;
+	}
+	for (i=0; i<dataSize; i++) {
+		for (j=0; j<elementSize; j++) {
+			result[i * elementSize + j] = data[j * dataSize + i];
+		}
+	}
+}
+
+
+
+/**
+ * Number of doubles encodeSafeShuffled and decodeSafeShuffled
+ * keep in a stack buffer between prediction and transposition.
+ */
+static const size_t SAFE_SHUFFLE_BLOCK = 256;
+
+size_t encodeSafeShuffled(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SAFE_SHUFFLED, dataSize, 0);
+	size_t i, j, bi, block;
+	unsigned char buffer[SAFE_SHUFFLE_BLOCK * 8];
+	double latest[3];
+	double value;
+	const unsigned char *fp = (const unsigned char*)&value;
+	
+	latest[1] = latest[2] = 0;
+	for (bi=0; bi<dataSize; bi+=SAFE_SHUFFLE_BLOCK) {
+		block = min(SAFE_SHUFFLE_BLOCK, dataSize - bi);
+		for (i=0; i<block; i++) {
+			latest[0] = latest[1];
+			latest[1] = latest[2];
+			latest[2] = data[bi + i];
+			value = bi + i < 2 ? latest[2] : latest[2] - (latest[1] + (latest[1] - latest[0]));
+			for (j=0; j<8; j++) {
+				buffer[i*8 + j] = fp[IS_BIG_ENDIAN ? (7-j) : j];
+			}
+		}
+		shuffle8(buffer, block, &result[bi], dataSize);
+	}
+	return PROBE_ENCODE_RETURN(PROBE_SAFE_SHUFFLED, dataSize, dataSize * 8, 0);
+}
+
+
+
+size_t decodeSafeShuffled(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SAFE_SHUFFLED, data, dataSize, false);
+	size_t i, j, bi, block, count;
+	unsigned char buffer[SAFE_SHUFFLE_BLOCK * 8];
+	double latest[3];
+	double value;
+	unsigned char *fp = (unsigned char*)&value;
+	
+	if (dataSize % 8 != 0) 
+		throw "[MSNumpress::decodeSafeShuffled] Corrupt input data: number of bytes needs to be multiple of 8! ";
+	
+	count = dataSize / 8;
+	latest[1] = latest[2] = 0;
+	for (bi=0; bi<count; bi+=SAFE_SHUFFLE_BLOCK) {
+		block = min(SAFE_SHUFFLE_BLOCK, count - bi);
+		unshuffle8(&data[bi], block, count, buffer);
+		for (i=0; i<block; i++) {
+			for (j=0; j<8; j++) {
+				fp[j] = buffer[i*8 + (IS_BIG_ENDIAN ? (7-j) : j)];
+			}
+			latest[0] = latest[1];
+			latest[1] = latest[2];
+			latest[2] = bi + i < 2 ? value : (latest[1] + (latest[1] - latest[0])) + value;
+			result[bi + i] = latest[2];
+		}
+	}
+	return PROBE_DECODE_RETURN(PROBE_SAFE_SHUFFLED, count, data, dataSize, false);
+}
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+/**
+ * Shared implementation of encodePic and the spectrum block encoder, so 
+ * that the latter fires no encodePic probes.
+ */
+static size_t encodePicImpl(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result
+) {
+	size_t i, ri;
+	unsigned int x;
+	unsigned char halfBytes[10];
+	size_t halfByteCount;
+	size_t hbi;
+
+	//printf("Encoding %d doubles\n", (int)dataSize);
+
+	halfByteCount = 0;
+	ri = 0;
+
+	for (i=0; i<dataSize; i++) {
+		
+		if (THROW_ON_OVERFLOW && 
+				(data[i] + 0.5 > INT_MAX || data[i] < -0.5)		){
+			throw "[MSNumpress::encodePic] Cannot use Pic to encode a number larger than INT_MAX or smaller than 0.";
+		}
+		x = static_cast<unsigned int>(data[i] + 0.5);
+		//printf("%d %d %d,   extrapol: %d    diff: %d \n", ints[0], ints[1], ints[2], extrapol, diff);
+		encodeInt(x, &halfBytes[halfByteCount], &halfByteCount);
+		
+		for (hbi=1; hbi < halfByteCount; hbi+=2) {
+			result[ri] = static_cast<unsigned char>(
+					(halfBytes[hbi-1] << 4) | (halfBytes[hbi] & 0xf)
+				);
+			//printf("%x \n", result[ri]);
+			ri++;
+		}
+		if (halfByteCount % 2 != 0) {
+			halfBytes[0] = halfBytes[halfByteCount-1];
+			halfByteCount = 1;
+		} else {
+			halfByteCount = 0;
+		}
+	}
+	if (halfByteCount == 1) {
+		result[ri] = static_cast<unsigned char>(halfBytes[0] << 4);
+		ri++;
+	}
+	return ri;
+}
+
+
+
+size_t encodePic(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result
+) {
+	PROBE_ENCODE_ENTRY(PROBE_PIC, dataSize, 0);
+	return PROBE_ENCODE_RETURN(PROBE_PIC, dataSize, encodePicImpl(data, dataSize, result), 0);
+}
+
+
+
+/**
+ * Shared implementation of decodePic, decodePicSqrt and the spectrum block decoder,
+ * which throws instead of writing more than maxResult doubles. If bytesRead 
+ * is not NULL, decoding stops after maxResult doubles and the number of bytes 
+ * they took is stored in *bytesRead.
+ */
+static size_t decodePicImpl(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result,
+		size_t maxResult,
+		size_t *bytesRead = NULL
+) {
+	size_t ri;
+	unsigned int x;
+	size_t di;
+	size_t half;
+
+	//printf("ri      di      half    dSize   count\n");
+	
+	half = 0;
+	ri = 0;
+	di = 0;
+	
+	while (di < dataSize) {
+		if (di == (dataSize - 1) && half == 1) {
+			if ((data[di] & 0xf) == 0x0) {
+				break;
+			}
+		}
+		
+		if (ri >= maxResult) {
+			if (bytesRead != NULL) break;
+			throw "[MSNumpress::decodePic] Corrupt input data: more values than expected! ";
+		}
+		
+		decodeInt(&data[0], &di, dataSize, &half, &x);
+		
+		//printf("%7d %7d %7d %7d %7d\n", ri, di, half, dataSize, count);
+		
+		//printf("count: %d \n", count);
+		result[ri++] = static_cast<double>(x);
+	}
+
+	if (bytesRead != NULL) *bytesRead = di + half;
+	return ri;
+}
+
+
+
+size_t decodePic(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_PIC, data, dataSize, false);
+	return PROBE_DECODE_RETURN(PROBE_PIC, decodePicImpl(data, dataSize, result, static_cast<size_t>(-1)), data, dataSize, false);
+}
+
+
+
+void encodePic(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 5);
+	size_t encodedLength = encodePic(&data[0], dataSize, &result[0]);
+	result.resize(encodedLength);
+}
+
+
+
+void decodePic(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 2);
+	size_t decodedLength = decodePic(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+size_t encodePicSqrt(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_PIC_SQRT, dataSize, fixedPoint);
+	size_t i, ri;
+	double temp;
+	unsigned char halfBytes[10];
+	size_t halfByteCount;
+	size_t hbi;
+
+	encodeFixedPoint(fixedPoint, result);
+
+	halfByteCount = 0;
+	ri = 8;
+
+	for (i=0; i<dataSize; i++) {
+		if (THROW_ON_OVERFLOW && data[i] < -0.5) {
+			throw "[MSNumpress::encodePicSqrt] Cannot use PicSqrt to encode a number smaller than 0.";
+		}
+		temp = sqrt(max(data[i], 0.0)) * fixedPoint;
+		if (THROW_ON_OVERFLOW && temp + 0.5 > INT_MAX) {
+			throw "[MSNumpress::encodePicSqrt] Cannot encode a number whose scaled square root is larger than INT_MAX.";
+		}
+		encodeInt(static_cast<unsigned int>(temp + 0.5), &halfBytes[halfByteCount], &halfByteCount);
+		
+		for (hbi=1; hbi < halfByteCount; hbi+=2) {
+			result[ri] = static_cast<unsigned char>(
+					(halfBytes[hbi-1] << 4) | (halfBytes[hbi] & 0xf)
+				);
+			ri++;
+		}
+		if (halfByteCount % 2 != 0) {
+			halfBytes[0] = halfBytes[halfByteCount-1];
+			halfByteCount = 1;
+		} else {
+			halfByteCount = 0;
+		}
+	}
+	if (halfByteCount == 1) {
+		result[ri] = static_cast<unsigned char>(halfBytes[0] << 4);
+		ri++;
+	}
+	return PROBE_ENCODE_RETURN(PROBE_PIC_SQRT, dataSize, ri, fixedPoint);
+}
+
+
+
+size_t decodePicSqrt(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_PIC_SQRT, data, dataSize, true);
+	size_t i, n;
+	double fixedPoint, x;
+
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodePicSqrt] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	fixedPoint = decodeFixedPoint(data);
+	n = decodePicImpl(&data[8], dataSize - 8, result, static_cast<size_t>(-1));
+	
+	for (i=0; i<n; i++) {
+		x = result[i] / fixedPoint;
+		result[i] = x * x;
+	}
+	return PROBE_DECODE_RETURN(PROBE_PIC_SQRT, n, data, dataSize, true);
+}
+
+
+
+void encodePicSqrt(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 5 + 8);
+	size_t encodedLength = encodePicSqrt(&data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodePicSqrt(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize((dataSize - 8) * 2);
+	size_t decodedLength = decodePicSqrt(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+/////////////////////////////////////////////////////////////
+
+
+double optimalSlofFixedPoint(
+		const double *data, 
+		size_t dataSize
+) {
+	if (dataSize == 0) return 0;
+	
+	double maxData = -1;
+	double maxDouble;
+	double fp;
+
+	// log is monotonic, so only the largest value needs a log
+	for (size_t i=0; i<dataSize; i++) {
+		maxData = max(maxData, data[i]);
+	}
+	maxDouble = max(1.0, log(maxData+1));
+
+	fp = floor(0xFFFF / maxDouble);
+
+	//cout << "    max val: " << maxDouble << endl;
+	//cout << "fixed point: " << fp << endl;
+
+	return fp;
+}
+
+
+
+/**
+ * Encodes data as encodeSlof, but without the leading fixed point, as the 
+ * sections of a spectrum block.
+ */
+static size_t encodeSlofValues(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	size_t i, ri;
+	double temp;
+	unsigned short x;
+
+	ri = 0;
+	for (i=0; i<dataSize; i++) {
+		temp = log(data[i]+1) * fixedPoint;
+
+		if (THROW_ON_OVERFLOW && 
+				temp > USHRT_MAX		) {
+			throw "[MSNumpress::encodeSlof] Cannot encode a number that overflows USHRT_MAX.";
+		}
+
+		x = static_cast<unsigned short>(temp + 0.5);
+		result[ri++] = x & 0xff;
+		result[ri++] = (x >> 8) & 0xff; 
+	}
+	return ri;
+}
+
+
+
+size_t encodeSlof(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SLOF, dataSize, fixedPoint);
+	encodeFixedPoint(fixedPoint, result);
+	return PROBE_ENCODE_RETURN(PROBE_SLOF, dataSize, 
+			8 + encodeSlofValues(data, dataSize, &result[8], fixedPoint), fixedPoint);
+}
+
+
+
+/**
+ * Number of doubles encodeSlofFast takes logarithms of in one vectorizable 
+ * pass, a 256 bit vector.
+ */
+static const size_t SLOF_FAST_LANES = 4;
+
+/**
+ * Natural logarithm of x > 0, with a relative error below 1e-10. x is split
+ * into 2^e * m with sqrt(2)/2 <= m < sqrt(2), and log(m) = 2 atanh(s) with
+ * s = (m-1)/(m+1), |s| < 0.1716, is summed to the s^11 term. The split is
+ * done with integer arithmetic on the bits only, without branches or selects
+ * (which GCC does not if-convert for floating point), so loops over it 
+ * can vectorize.
+ */
+static inline double fastLog(
+		double x
+) {
+	const double LN2 = 0.69314718055994530942;
+	const unsigned long long MANTISSA = 0x000FFFFFFFFFFFFFULL;
+	const unsigned long long SQRT2_MANTISSA = 0x0006A09E667F3BCDULL;
+	unsigned long long bits, mantissa, big, eBits;
+	double e, m, s, s2;
+	
+	memcpy(&bits, &x, 8);
+	mantissa = bits & MANTISSA;
+	// 1 if the mantissa is above sqrt(2), so m is halved and e incremented
+	big = (SQRT2_MANTISSA - mantissa) >> 63;
+	
+	// biased exponent as the low bits of 2^52, then as a double
+	eBits = 0x4330000000000000ULL | ((bits >> 52) + big);
+	memcpy(&e, &eBits, 8);
+	e -= 4503599627370496.0 + 1023;
+	bits = mantissa | (0x3FF0000000000000ULL - (big << 52));
+	memcpy(&m, &bits, 8);
+	
+	s = (m - 1) / (m + 1);
+	s2 = s * s;
+	return e * LN2 + 2 * s * (1 + s2 * (1.0/3 + s2 * (1.0/5 + s2 * (1.0/7 
+			+ s2 * (1.0/9 + s2 * (1.0/11))))));
+}
+
+
+
+size_t encodeSlofFast(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SLOF_FAST, dataSize, fixedPoint);
+	size_t i, bi, block, ri;
+	double padded[SLOF_FAST_LANES];
+	double temp[SLOF_FAST_LANES];
+	const double *values;
+	unsigned short x;
+	encodeFixedPoint(fixedPoint, result);
+
+	ri = 8;
+	for (bi=0; bi<dataSize; bi+=SLOF_FAST_LANES) {
+		block = min(SLOF_FAST_LANES, dataSize - bi);
+		values = &data[bi];
+		if (block < SLOF_FAST_LANES) {
+			// the last few values are padded with zeros, as GCC only vectorizes 
+			// the loop below at -O2 with a constant number of iterations
+			memcpy(padded, values, block * sizeof(double));
+			for (i=block; i<SLOF_FAST_LANES; i++) padded[i] = 0;
+			values = padded;
+		}
+		for (i=0; i<SLOF_FAST_LANES; i++) {
+			temp[i] = fastLog(values[i]+1) * fixedPoint;
+		}
+		for (i=0; i<block; i++) {
+			if (THROW_ON_OVERFLOW && 
+					temp[i] > USHRT_MAX		) {
+				throw "[MSNumpress::encodeSlofFast] Cannot encode a number that overflows USHRT_MAX.";
+			}
+
+			x = static_cast<unsigned short>(temp[i] + 0.5);
+			result[ri++] = x & 0xff;
+			result[ri++] = (x >> 8) & 0xff; 
+		}
+	}
+	return PROBE_ENCODE_RETURN(PROBE_SLOF_FAST, dataSize, ri, fixedPoint);
+}
+
+
+
+/**
+ * Decodes data encoded by encodeSlofValues with fixedPoint.
+ */
+static size_t decodeSlofValues(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double fixedPoint,
+		double *result
+) {
+	size_t i, ri;
+	unsigned short x;
+
+	ri = 0;
+	for (i=0; i<dataSize; i+=2) {
+		x = static_cast<unsigned short>(data[i] | (data[i+1] << 8));
+		result[ri++] = exp(x / fixedPoint) - 1;
+	}
+	return ri;
+}
+
+
+
+size_t decodeSlof(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SLOF, data, dataSize, true);
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeSlof] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	return PROBE_DECODE_RETURN(PROBE_SLOF, 
+			decodeSlofValues(&data[8], dataSize - 8, decodeFixedPoint(data), result), data, dataSize, true);
+}
+
+
+
+size_t decodeSlofLog(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SLOF_LOG, data, dataSize, true);
+	size_t i, n;
+	double fixedPoint;
+
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeSlofLog] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	fixedPoint = decodeFixedPoint(data);
+	n = (dataSize - 8) / 2;
+
+	for (i=0; i<n; i++) {
+		result[i] = (data[8+2*i] | (data[9+2*i] << 8)) / fixedPoint;
+	}
+	return PROBE_DECODE_RETURN(PROBE_SLOF_LOG, n, data, dataSize, true);
+}
+
+
+
+/**
+ * Rounds f to the nearest IEEE 754 half precision float, ties to even,
+ * as the F16C conversion instructions do.
+ */
+static unsigned short floatToHalf(
+		float f
+) {
+	unsigned int x, absx, e, m, shift, rem, halfway;
+	unsigned short sign, h;
+	
+	memcpy(&x, &f, 4);
+	sign = static_cast<unsigned short>((x >> 16) & 0x8000);
+	absx = x & 0x7fffffff;
+	e = absx >> 23;
+	
+	if (absx > 0x7f800000) return sign | 0x7e00; 	// nan
+	if (e >= 143) return sign | 0x7c00; 			// inf, or overflows to inf
+	if (e < 102) return sign; 						// below half the smallest subnormal
+	
+	if (e < 113) {
+		// subnormal half
+		m = (absx & 0x7fffff) | 0x800000;
+		shift = 126 - e;
+		h = static_cast<unsigned short>(m >> shift);
+		rem = m & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	} else {
+		h = static_cast<unsigned short>(((e - 112) << 10) | ((absx & 0x7fffff) >> 13));
+		rem = absx & 0x1fff;
+		halfway = 0x1000;
+	}
+	if (rem > halfway || (rem == halfway && (h & 1))) {
+		h++; // may carry into the exponent, up to inf
+	}
+	return sign | h;
+}
+
+
+
+/**
+ * e^x for -708 < x < 12, with a relative error below 1e-12. x is split into 
+ * n ln(2) + r with integer n and |r| <= ln(2)/2, e^r is summed to the r^10 
+ * term, and 2^n is built in the exponent bits. n is rounded by adding and 
+ * subtracting 1.5 * 2^52 rather than with floor, which needs SSE4.1 to
+ * vectorize, so that, as with fastLog, loops over it can vectorize.
+ */
+static inline double fastExp(
+		double x
+) {
+	const double LOG2E = 1.44269504088896340736;
+	const double LN2_HI = 6.93147180369123816490e-01;
+	const double LN2_LO = 1.90821492927058770002e-10;
+	const double ROUND = 6755399441055744.0;
+	unsigned long long bits;
+	double k, n, r, scale;
+	
+	k = x * LOG2E + ROUND;
+	n = k - ROUND;
+	r = x - n * LN2_HI - n * LN2_LO;
+	
+	// n as the low bits of k, moved into the exponent of 2^n
+	memcpy(&bits, &k, 8);
+	bits = (bits + 1023) << 52;
+	memcpy(&scale, &bits, 8);
+	
+	return scale * (1 + r * (1 + r * (1.0/2 + r * (1.0/6 + r * (1.0/24 
+			+ r * (1.0/120 + r * (1.0/720 + r * (1.0/5040 + r * (1.0/40320 
+			+ r * (1.0/362880 + r * (1.0/3628800)))))))))));
+}
+
+
+
+/**
+ * The exponent decodeSlofHalf scales by: the smallest e >= -64 for which 
+ * the largest value Slof can store with fixedPoint, e^(65535/fixedPoint)-1,
+ * is at most the largest half, 65504, times 2^e.
+ */
+static int slofHalfExponent(
+		double fixedPoint
+) {
+	double maxValue;
+	int e;
+	
+	if (!(fixedPoint > 0) || 65535 / fixedPoint > 700) 
+		throw "[MSNumpress::decodeSlofHalf] Cannot decode a fixed point whose largest value overflows DBL_MAX.";
+	
+	maxValue = exp(65535 / fixedPoint) - 1;
+	frexp(maxValue / 65504, &e);
+	e = max(e - 1, -64);
+	while (ldexp(maxValue, -e) > 65504) e++;
+	return e;
+}
+
+
+
+size_t decodeSlofHalf(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		unsigned short *result,
+		int *exponent
+) {
+	PROBE_DECODE_ENTRY(PROBE_SLOF_HALF, data, dataSize, true);
+	const double LN2 = 0.69314718055994530942;
+	size_t i, j, n;
+	double fixedPoint, shift, offset;
+	double temp[8];
+	float values[8];
+
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeSlofHalf] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	fixedPoint = decodeFixedPoint(data);
+	*exponent = slofHalfExponent(fixedPoint);
+	n = (dataSize - 8) / 2;
+	
+	// (e^(x/fixedPoint) - 1) / 2^e, computed without leaving half range
+	shift = *exponent * LN2;
+	offset = ldexp(1.0, -*exponent);
+
+	for (i=0; i+8<=n; i+=8) {
+		// gathered into doubles first, as GCC does not vectorize the exp loop 
+		// when it also reads the bytes
+		for (j=0; j<8; j++) {
+			temp[j] = data[8+2*(i+j)] | (data[9+2*(i+j)] << 8);
+		}
+		for (j=0; j<8; j++) {
+			temp[j] = fastExp(temp[j] / fixedPoint - shift) - offset;
+		}
+		for (j=0; j<8; j++) {
+			values[j] = static_cast<float>(temp[j]);
+		}
+#ifdef __F16C__
+		_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(&result[i]), 
+				_mm256_cvtps_ph(_mm256_loadu_ps(values), _MM_FROUND_TO_NEAREST_INT));
+#else
+		for (j=0; j<8; j++) {
+			result[i+j] = floatToHalf(values[j]);
+		}
+#endif
+	}
+	for (; i<n; i++) {
+		result[i] = floatToHalf(static_cast<float>(fastExp(
+				(data[8+2*i] | (data[9+2*i] << 8)) / fixedPoint - shift) - offset));
+	}
+	return PROBE_DECODE_RETURN(PROBE_SLOF_HALF, n, data, dataSize, true);
+}
+
+
+
+size_t encodeSlofShuffled(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SLOF_SHUFFLED, dataSize, fixedPoint);
+	size_t i;
+	double temp;
+	unsigned short x;
+	encodeFixedPoint(fixedPoint, result);
+
+	for (i=0; i<dataSize; i++) {
+		temp = log(data[i]+1) * fixedPoint;
+
+		if (THROW_ON_OVERFLOW && 
+				temp > USHRT_MAX		) {
+			throw "[MSNumpress::encodeSlofShuffled] Cannot encode a number that overflows USHRT_MAX.";
+		}
+
+		x = static_cast<unsigned short>(temp + 0.5);
+		result[8 + i] = x & 0xff;
+		result[8 + dataSize + i] = (x >> 8) & 0xff; 
+	}
+	return PROBE_ENCODE_RETURN(PROBE_SLOF_SHUFFLED, dataSize, 8 + dataSize * 2, fixedPoint);
+}
+
+
+
+size_t decodeSlofShuffled(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SLOF_SHUFFLED, data, dataSize, true);
+	size_t i, n;
+	double fixedPoint;
+
+	if (dataSize < 8 || dataSize % 2 != 0) 
+		throw "[MSNumpress::decodeSlofShuffled] Corrupt input data: need 8 bytes of fixed point and an even number of bytes! ";
+	
+	fixedPoint = decodeFixedPoint(data);
+	n = (dataSize - 8) / 2;
+
+	for (i=0; i<n; i++) {
+		result[i] = exp((data[8 + i] | (data[8 + n + i] << 8)) / fixedPoint) - 1;
+	}
+	return PROBE_DECODE_RETURN(PROBE_SLOF_SHUFFLED, n, data, dataSize, true);
+}
+
+
+
+void encodeSlof(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 2 + 8);
+	size_t encodedLength = encodeSlof(&data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void encodeSlofFast(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 2 + 8);
+	size_t encodedLength = encodeSlofFast(&data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeSlof(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize((dataSize - 8) / 2);
+	size_t decodedLength = decodeSlof(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+
+void decodeSlofLog(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize((dataSize - 8) / 2);
+	size_t decodedLength = decodeSlofLog(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+
+void decodeSlofHalf(
+		const std::vector<unsigned char> &data,  
+		std::vector<unsigned short> &result,
+		int *exponent
+) {
+	size_t dataSize = data.size();
+	result.resize((dataSize - 8) / 2);
+	size_t decodedLength = decodeSlofHalf(&data[0], dataSize, &result[0], exponent);
+	result.resize(decodedLength);
+}
+
+
+
+size_t encodeSlofLinear(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SLOF_LINEAR, dataSize, fixedPoint);
+	size_t i, ri;
+	double temp;
+	int ints[3];
+	int extrapol;
+	unsigned char halfBytes[10];
+	size_t halfByteCount;
+	size_t hbi;
+
+	encodeFixedPoint(fixedPoint, result);
+
+	halfByteCount = 0;
+	ri = 8;
+	ints[1] = ints[2] = 0;
+	
+	for (i=0; i<dataSize; i++) {
+		temp = log(data[i]+1) * fixedPoint;
+
+		if (THROW_ON_OVERFLOW && 
+				temp > USHRT_MAX		) {
+			throw "[MSNumpress::encodeSlofLinear] Cannot encode a number that overflows USHRT_MAX.";
+		}
+
+		ints[0] = ints[1];
+		ints[1] = ints[2];
+		ints[2] = static_cast<unsigned short>(temp + 0.5);
+		extrapol = i == 0 ? 0 : (i == 1 ? ints[1] : ints[1] + (ints[1] - ints[0]));
+		
+		encodeInt(
+				static_cast<unsigned int>(ints[2] - extrapol), 
+				&halfBytes[halfByteCount], 
+				&halfByteCount
+			);
+		
+		for (hbi=1; hbi < halfByteCount; hbi+=2) {
+			result[ri] = static_cast<unsigned char>(
+					(halfBytes[hbi-1] << 4) | (halfBytes[hbi] & 0xf)
+				);
+			ri++;
+		}
+		if (halfByteCount % 2 != 0) {
+			halfBytes[0] = halfBytes[halfByteCount-1];
+			halfByteCount = 1;
+		} else {
+			halfByteCount = 0;
+		}
+	}
+	if (halfByteCount == 1) {
+		result[ri] = static_cast<unsigned char>(halfBytes[0] << 4);
+		ri++;
+	}
+	return PROBE_ENCODE_RETURN(PROBE_SLOF_LINEAR, dataSize, ri, fixedPoint);
+}
+
+
+
+/**
+ * Number of exponentials decodeSlofLinear remembers, by the low bits of the
+ * quantized logarithm.
+ */
+static const size_t SLOF_LINEAR_EXPS = 1024;
+
+size_t decodeSlofLinear(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_SLOF_LINEAR, data, dataSize, true);
+	size_t i, ri, di, half, slot;
+	unsigned int buff;
+	long long ints[3];
+	long long extrapol;
+	int q;
+	int quantized[SLOF_LINEAR_EXPS];
+	double exps[SLOF_LINEAR_EXPS];
+	double fixedPoint;
+
+	if (dataSize < 8) 
+		throw "[MSNumpress::decodeSlofLinear] Corrupt input data: not enough bytes to read fixed point! ";
+	
+	fixedPoint = decodeFixedPoint(data);
+	
+	ints[1] = ints[2] = 0;
+	half = 0;
+	ri = 0;
+	di = 8;
+	
+	// prefix sum of the residuals into the quantized logarithms
+	while (di < dataSize) {
+		if (di == (dataSize - 1) && half == 1) {
+			if ((data[di] & 0xf) == 0x0) {
+				break;
+			}
+		}
+		
+		decodeInt(data, &di, dataSize, &half, &buff);
+		
+		// in long long, as corrupt residuals can overflow an int
+		extrapol = ri == 0 ? 0 : (ri == 1 ? ints[2] : ints[2] + (ints[2] - ints[1]));
+		ints[0] = ints[1];
+		ints[1] = ints[2];
+		ints[2] = extrapol + static_cast<int>(buff);
+		if (ints[2] < 0 || ints[2] > USHRT_MAX) 
+			throw "[MSNumpress::decodeSlofLinear] Corrupt input data: value out of range! ";
+		
+		result[ri++] = static_cast<double>(ints[2]);
+	}
+	
+	// the exp in a separate pass, free of the serial dependency above. 
+	// Profiles repeat quantized values, on the baseline and between 
+	// neighbouring points, so recently used exponentials are looked up, 
+	// which gives the same doubles as computing them each time
+	for (i=0; i<SLOF_LINEAR_EXPS; i++) {
+		quantized[i] = -1;
+	}
+	for (i=0; i<ri; i++) {
+		q = static_cast<int>(result[i]);
+		slot = static_cast<size_t>(q) & (SLOF_LINEAR_EXPS - 1);
+		if (quantized[slot] != q) {
+			quantized[slot] = q;
+			exps[slot] = exp(q / fixedPoint) - 1;
+		}
+		result[i] = exps[slot];
+	}
+	
+	return PROBE_DECODE_RETURN(PROBE_SLOF_LINEAR, ri, data, dataSize, true);
+}
+
+
+
+void encodeSlofLinear(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 5 + 9);
+	size_t encodedLength = encodeSlofLinear(&data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeSlofLinear(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize((dataSize - 8) * 2);
+	size_t decodedLength = decodeSlofLinear(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+double optimalStepFixedPoint(
+		const double *data, 
+		size_t dataSize
+) {
+	if (dataSize == 0) return 0;
+	
+	double values[3];
+	double maxDouble = ceil(abs(data[0])+1);
+	size_t runs = 1;
+	
+	values[0] = values[1] = 0;
+	values[2] = data[0];
+	for (size_t i=1; i<dataSize; i++) {
+		if (data[i] == values[2]) continue;
+		values[0] = values[1];
+		values[1] = values[2];
+		values[2] = data[i];
+		runs++;
+		if (runs == 2) {
+			maxDouble = max(maxDouble, ceil(abs(values[2] - values[1])+1));
+		} else {
+			maxDouble = max(maxDouble, ceil(abs(values[2] - 2*values[1] + values[0])+1));
+		}
+	}
+
+	return floor(0x7FFFFFFFl / maxDouble);
+}
+
+
+
+size_t encodeStep(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_STEP, dataSize, fixedPoint);
+	long long ints[3];
+	long long x = 0;
+	size_t i, ri, runStart;
+	unsigned char halfBytes[20];
+	size_t halfByteCount;
+	size_t hbi;
+	long long extrapol;
+	size_t runs;
+
+	encodeFixedPoint(fixedPoint, result);
+
+	if (dataSize > 0xFFFFFFFF) 
+		throw "[MSNumpress::encodeStep] Cannot encode more than 2^32 - 1 values.";
+	encodeUInt32(dataSize, &result[8]);
+	if (dataSize == 0) 
+		return PROBE_ENCODE_RETURN(PROBE_STEP, dataSize, 12, fixedPoint);
+
+	halfByteCount = 0;
+	ri = 12;
+	ints[1] = ints[2] = 0;
+	runs = 0;
+	runStart = 0;
+
+	for (i=0; i<=dataSize; i++) {
+		if (i < dataSize) {
+			if (THROW_ON_OVERFLOW && 
+					abs(data[i] * fixedPoint) + 0.5 > LLONG_MAX	) {
+				throw "[MSNumpress::encodeStep] Next number overflows LLONG_MAX.";
+			}
+			x = static_cast<long long>(data[i] * fixedPoint + 0.5);
+			if (i == 0 || x == ints[2]) {
+				ints[2] = x;
+				continue;
+			}
+		}
+		
+		// close the run [runStart, i) with value ints[2]
+		extrapol = runs == 0 ? 0 : (runs == 1 ? ints[1] : ints[1] + (ints[1] - ints[0]));
+		
+		if (THROW_ON_OVERFLOW && 
+				(		ints[2] - extrapol > INT_MAX 
+					|| 	ints[2] - extrapol < INT_MIN	)) {
+			throw "[MSNumpress::encodeStep] Cannot encode a number that exceeds the bounds of [-INT_MAX, INT_MAX].";
+		}
+		
+		encodeInt(
+				static_cast<unsigned int>(static_cast<int>(ints[2] - extrapol)), 
+				&halfBytes[halfByteCount], 
+				&halfByteCount
+			);
+		encodeInt(
+				static_cast<unsigned int>(i - runStart - 1), 
+				&halfBytes[halfByteCount], 
+				&halfByteCount
+			);
+		
+		for (hbi=1; hbi < halfByteCount; hbi+=2) {
+			result[ri] = static_cast<unsigned char>(
+					(halfBytes[hbi-1] << 4) | (halfBytes[hbi] & 0xf)
+				);
+			ri++;
+		}
+		if (halfByteCount % 2 != 0) {
+			halfBytes[0] = halfBytes[halfByteCount-1];
+			halfByteCount = 1;
+		} else {
+			halfByteCount = 0;
+		}
+		
+		if (i == dataSize) break;
+		
+		runs++;
+		runStart = i;
+		ints[0] = ints[1];
+		ints[1] = ints[2];
+		ints[2] = x;
+	}
+	if (halfByteCount == 1) {
+		result[ri] = static_cast<unsigned char>(halfBytes[0] << 4);
+		ri++;
+	}
+	return PROBE_ENCODE_RETURN(PROBE_STEP, dataSize, ri, fixedPoint);
+}
+
+
+
+size_t decodeStepLength(
+		const unsigned char *data,
+		const size_t dataSize
+) {
+	if (dataSize < 12) 
+		throw "[MSNumpress::decodeStep] Corrupt input data: not enough bytes to read header! ";
+	
+	return decodeUInt32(&data[8]);
+}
+
+
+
+size_t decodeStep(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_STEP, data, dataSize, true);
+	size_t count, ri, di, half, runs;
+	size_t runLength;
+	unsigned int buff;
+	long long ints[3];
+	long long extrapol;
+	double fixedPoint;
+	double value;
+
+	count 		= decodeStepLength(data, dataSize);
+	fixedPoint 	= decodeFixedPoint(data);
+	
+	ints[1] = ints[2] = 0;
+	runs = 0;
+	half = 0;
+	ri = 0;
+	di = 12;
+	
+	while (ri < count) {
+		if (di >= dataSize) 
+			throw "[MSNumpress::decodeStep] Corrupt input data: fewer values than expected! ";
+		decodeInt(data, &di, dataSize, &half, &buff);
+		if (di >= dataSize) 
+			throw "[MSNumpress::decodeStep] Corrupt input data: missing run length! ";
+		extrapol = runs == 0 ? 0 : (runs == 1 ? ints[2] : ints[2] + (ints[2] - ints[1]));
+		ints[0] = ints[1];
+		ints[1] = ints[2];
+		ints[2] = extrapol + static_cast<int>(buff);
+		runs++;
+		
+		decodeInt(data, &di, dataSize, &half, &buff);
+		runLength = static_cast<size_t>(buff) + 1;
+		if (runLength > count - ri) 
+			throw "[MSNumpress::decodeStep] Corrupt input data: more values than expected! ";
+		
+		value = ints[2] / fixedPoint;
+		std::fill(&result[ri], &result[ri] + runLength, value);
+		ri += runLength;
+	}
+	
+	if (di + half != dataSize) 
+		throw "[MSNumpress::decodeStep] Corrupt input data: trailing bytes after last run! ";
+
+	return PROBE_DECODE_RETURN(PROBE_STEP, ri, data, dataSize, true);
+}
+
+
+
+void encodeStep(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double fixedPoint
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 9 + 13);
+	size_t encodedLength = encodeStep(data.empty() ? NULL : &data[0], dataSize, &result[0], fixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeStep(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize(decodeStepLength(&data[0], dataSize));
+	size_t decodedLength = decodeStep(&data[0], dataSize, result.empty() ? NULL : &result[0]);
+	result.resize(decodedLength);
+}
+
+/////////////////////////////////////////////////////////////
+
+
+static const unsigned char CALIBRATED_BINS 		= 0;
+static const unsigned char CALIBRATED_LINEAR 	= 1;
+
+/**
+ * Largest time bin, such that linear prediction residuals of bins
+ * always fit in an int.
+ */
+static const double CALIBRATED_MAX_BIN = 0x3FFFFFFF;
+
+size_t encodeCalibrated(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double a,
+		double b,
+		double tolerance
+) {
+	PROBE_ENCODE_ENTRY(PROBE_CALIBRATED, dataSize, 0);
+	size_t i;
+	double t, mz;
+	std::vector<double> bins(dataSize);
+	
+	if (dataSize > 0xFFFFFFFF) 
+		throw "[MSNumpress::encodeCalibrated] Cannot encode more than 2^32 - 1 values.";
+	encodeUInt32(dataSize, &result[1]);
+
+	for (i=0; i<dataSize; i++) {
+		t = floor((sqrt(data[i]) - b) / a + 0.5);
+		mz = (a * t + b) * (a * t + b);
+		if (!(t >= 0 && t <= CALIBRATED_MAX_BIN && abs(mz - data[i]) <= tolerance)) break;
+		bins[i] = t;
+	}
+
+	if (i < dataSize) {
+		result[0] = CALIBRATED_LINEAR;
+		return PROBE_ENCODE_RETURN(PROBE_CALIBRATED, dataSize, 5 + encodeLinearImpl(data, dataSize, &result[5], 
+				optimalLinearFixedPoint(data, dataSize), false), 0);
+	}
+
+	result[0] = CALIBRATED_BINS;
+	encodeFixedPoint(a, &result[5]);
+	encodeFixedPoint(b, &result[13]);
+	return PROBE_ENCODE_RETURN(PROBE_CALIBRATED, dataSize, 21 + encodeLinearValues(bins.empty() ? NULL : &bins[0], dataSize, &result[21], 1.0, true), 0);
+}
+
+
+
+size_t decodeCalibratedLength(
+		const unsigned char *data,
+		const size_t dataSize
+) {
+	if (dataSize < 5) 
+		throw "[MSNumpress::decodeCalibrated] Corrupt input data: not enough bytes to read header! ";
+	
+	return decodeUInt32(&data[1]);
+}
+
+
+
+size_t decodeCalibrated(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result
+) {
+	PROBE_DECODE_ENTRY(PROBE_CALIBRATED, data, dataSize, false);
+	size_t i, n;
+	size_t count = decodeCalibratedLength(data, dataSize);
+	double a, b, x;
+
+	if (data[0] == CALIBRATED_LINEAR) {
+		n = decodeLinearImpl(&data[5], dataSize - 5, result, count);
+	} else if (data[0] == CALIBRATED_BINS) {
+		if (dataSize < 21) 
+			throw "[MSNumpress::decodeCalibrated] Corrupt input data: not enough bytes to read calibration! ";
+		a = decodeFixedPoint(&data[5]);
+		b = decodeFixedPoint(&data[13]);
+		n = decodeLinearRunsValues(&data[21], dataSize - 21, 1.0, result, count);
+		for (i=0; i<n; i++) {
+			x = a * result[i] + b;
+			result[i] = x * x;
+		}
+	} else {
+		throw "[MSNumpress::decodeCalibrated] Corrupt input data: unknown mode! ";
+	}
+	
+	if (n != count) 
+		throw "[MSNumpress::decodeCalibrated] Corrupt input data: fewer values than expected! ";
+	return PROBE_DECODE_RETURN(PROBE_CALIBRATED, n, data, dataSize, false);
+}
+
+
+
+void encodeCalibrated(
+		const std::vector<double> &data,  
+		std::vector<unsigned char> &result,
+		double a,
+		double b,
+		double tolerance
+) {
+	size_t dataSize = data.size();
+	result.resize(dataSize * 5 + 21);
+	size_t encodedLength = encodeCalibrated(&data[0], dataSize, &result[0], a, b, tolerance);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeCalibrated(
+		const std::vector<unsigned char> &data,  
+		std::vector<double> &result
+) {
+	size_t dataSize = data.size();
+	result.resize(decodeCalibratedLength(&data[0], dataSize));
+	size_t decodedLength = decodeCalibrated(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+/////////////////////////////////////////////////////////////
+
+
+static const size_t SPECTRUM_MAX_HEADER_SIZE = 17;
+static const unsigned char SPECTRUM_CODEC_MASK 	= 0x01;
+static const unsigned char SPECTRUM_HAS_IM 		= 0x02;
+
+/**
+ * Rounds a fixed point towards zero to the float stored in a spectrum block
+ * header, so that no value is scaled beyond the range its fixed point was 
+ * chosen for.
+ */
+static float spectrumFixedPoint(
+		double fixedPoint
+) {
+	float f;
+	unsigned int bits;
+
+	if (!(abs(fixedPoint) <= FLT_MAX))
+		throw "[MSNumpress::encodeSpectrum] Fixed point is out of float range.";
+
+	f = static_cast<float>(fixedPoint);
+	if (f > 0 && f > fixedPoint) {
+		memcpy(&bits, &f, 4);
+		bits--;
+		memcpy(&f, &bits, 4);
+	}
+	return f;
+}
+
+
+
+static void encodeSpectrumFixedPoint(
+		float fixedPoint,
+		unsigned char *result
+) {
+	unsigned int bits;
+	memcpy(&bits, &fixedPoint, 4);
+	encodeUInt32(bits, result);
+}
+
+
+
+static double decodeSpectrumFixedPoint(
+		const unsigned char *data
+) {
+	unsigned int bits = static_cast<unsigned int>(decodeUInt32(data));
+	float fixedPoint;
+	memcpy(&fixedPoint, &bits, 4);
+	return fixedPoint;
+}
+
+
+
+/**
+ * Reads the leading varint of a spectrum block into the number of peaks and 
+ * the flags, returning the number of bytes it took.
+ */
+static size_t decodeSpectrumHeader(
+		const unsigned char *data,
+		const size_t dataSize,
+		size_t *count,
+		unsigned char *flags
+) {
+	size_t di = 0;
+	unsigned long long x = 0;
+
+	do {
+		if (di >= dataSize || di >= 5) 
+			throw "[MSNumpress::decodeSpectrum] Corrupt input data: not enough bytes to read header! ";
+		x = x | (static_cast<unsigned long long>(data[di] & 0x7f) << (7*di));
+	} while (data[di++] & 0x80);
+
+	if ((x >> 2) > 0xFFFFFFFF)
+		throw "[MSNumpress::decodeSpectrum] Corrupt input data: too many peaks! ";
+	*count = static_cast<size_t>(x >> 2);
+	*flags = static_cast<unsigned char>(x & 0x03);
+	return di;
+}
+
+
+
+size_t encodeSpectrum(
+		const double *mz,
+		const double *intensity,
+		const double *ionMobility,
+		const size_t dataSize,
+		unsigned char *result,
+		double mzFixedPoint,
+		IntensityCodec intensityCodec,
+		double intensityFixedPoint,
+		double ionMobilityFixedPoint
+) {
+	PROBE_ENCODE_ENTRY(PROBE_SPECTRUM, dataSize, 0);
+	size_t ri = 0;
+	unsigned long long x;
+	float mzFp, intensityFp = 0, imFp = 0;
+
+	if (dataSize > 0xFFFFFFFF) 
+		throw "[MSNumpress::encodeSpectrum] Cannot encode more than 2^32 - 1 peaks.";
+	if (intensityCodec != INTENSITY_SLOF && intensityCodec != INTENSITY_PIC)
+		throw "[MSNumpress::encodeSpectrum] Unknown intensity codec.";
+
+	mzFp = spectrumFixedPoint(mzFixedPoint);
+	if (intensityCodec == INTENSITY_SLOF) 
+		intensityFp = spectrumFixedPoint(intensityFixedPoint);
+	if (ionMobility != NULL) 
+		imFp = spectrumFixedPoint(ionMobilityFixedPoint);
+
+	// the number of peaks and the flags share one varint
+	x = (static_cast<unsigned long long>(dataSize) << 2) 
+			| static_cast<unsigned long long>(intensityCodec) 
+			| (ionMobility != NULL ? SPECTRUM_HAS_IM : 0);
+	while (x >= 0x80) {
+		result[ri++] = static_cast<unsigned char>((x & 0x7f) | 0x80);
+		x = x >> 7;
+	}
+	result[ri++] = static_cast<unsigned char>(x);
+
+	encodeSpectrumFixedPoint(mzFp, &result[ri]);
+	ri += 4;
+	if (intensityCodec == INTENSITY_SLOF) {
+		encodeSpectrumFixedPoint(intensityFp, &result[ri]);
+		ri += 4;
+	}
+	if (ionMobility != NULL) {
+		encodeSpectrumFixedPoint(imFp, &result[ri]);
+		ri += 4;
+	}
+
+	ri += encodeLinearValues(mz, dataSize, &result[ri], mzFp, false);
+
+	if (intensityCodec == INTENSITY_SLOF) {
+		ri += encodeSlofValues(intensity, dataSize, &result[ri], intensityFp);
+	} else {
+		ri += encodePicImpl(intensity, dataSize, &result[ri]);
+	}
+
+	if (ionMobility != NULL) {
+		ri += encodeLinearValues(ionMobility, dataSize, &result[ri], imFp, false);
+	}
+
+	return PROBE_ENCODE_RETURN(PROBE_SPECTRUM, dataSize, ri, 0);
+}
+
+
+
+size_t decodeSpectrumLength(
+		const unsigned char *data,
+		const size_t dataSize
+) {
+	size_t count;
+	unsigned char flags;
+	decodeSpectrumHeader(data, dataSize, &count, &flags);
+	return count;
+}
+
+
+
+bool spectrumHasIonMobility(
+		const unsigned char *data,
+		const size_t dataSize
+) {
+	size_t count;
+	unsigned char flags;
+	decodeSpectrumHeader(data, dataSize, &count, &flags);
+	return (flags & SPECTRUM_HAS_IM) != 0;
+}
+
+
+
+size_t decodeSpectrum(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *mz,
+		double *intensity,
+		double *ionMobility
+) {
+	PROBE_DECODE_ENTRY(PROBE_SPECTRUM, data, dataSize, false);
+	size_t count, n, sectionBytes;
+	size_t di, fixedPoints;
+	double mzFixedPoint, intensityFixedPoint = 0, imFixedPoint = 0;
+	unsigned char flags, codec;
+	bool hasIonMobility;
+
+	di 				= decodeSpectrumHeader(data, dataSize, &count, &flags);
+	codec 			= flags & SPECTRUM_CODEC_MASK;
+	hasIonMobility 	= (flags & SPECTRUM_HAS_IM) != 0;
+
+	fixedPoints 	= 1 + (codec == INTENSITY_SLOF ? 1 : 0) + (hasIonMobility ? 1 : 0);
+
+	if (dataSize - di < 4 * fixedPoints) 
+		throw "[MSNumpress::decodeSpectrum] Corrupt input data: not enough bytes to read header! ";
+
+	mzFixedPoint = decodeSpectrumFixedPoint(&data[di]);
+	di += 4;
+	if (codec == INTENSITY_SLOF) {
+		intensityFixedPoint = decodeSpectrumFixedPoint(&data[di]);
+		di += 4;
+	}
+	if (hasIonMobility) {
+		imFixedPoint = decodeSpectrumFixedPoint(&data[di]);
+		di += 4;
+	}
+
+	// a section ends after count values, the last one with the block
+	n = decodeLinearValues(&data[di], dataSize - di, mzFixedPoint, mz, count, &sectionBytes);
+	if (n != count)
+		throw "[MSNumpress::decodeSpectrum] Corrupt input data: fewer m/z values than peaks! ";
+	di += sectionBytes;
+
+	if (codec == INTENSITY_SLOF) {
+		if (count > (dataSize - di) / 2)
+			throw "[MSNumpress::decodeSpectrum] Corrupt input data: fewer intensities than peaks! ";
+		sectionBytes = count * 2;
+		n = decodeSlofValues(&data[di], sectionBytes, intensityFixedPoint, intensity);
+	} else if (hasIonMobility) {
+		n = decodePicImpl(&data[di], dataSize - di, intensity, count, &sectionBytes);
+	} else {
+		sectionBytes = dataSize - di;
+		n = decodePicImpl(&data[di], sectionBytes, intensity, count);
+	}
+	if (n != count)
+		throw "[MSNumpress::decodeSpectrum] Corrupt input data: fewer intensities than peaks! ";
+	di += sectionBytes;
+
+	if (!hasIonMobility && di != dataSize)
+		throw "[MSNumpress::decodeSpectrum] Corrupt input data: trailing bytes after intensity section! ";
+
+	if (hasIonMobility && ionMobility != NULL) {
+		n = decodeLinearValues(&data[di], dataSize - di, imFixedPoint, ionMobility, count);
+		if (n != count)
+			throw "[MSNumpress::decodeSpectrum] Corrupt input data: ion mobility count does not match header! ";
+	}
+
+	return PROBE_DECODE_RETURN(PROBE_SPECTRUM, count, data, dataSize, false);
+}
+
+
+
+void encodeSpectrum(
+		const std::vector<double> &mz,
+		const std::vector<double> &intensity,
+		const std::vector<double> &ionMobility,
+		std::vector<unsigned char> &result,
+		double mzFixedPoint,
+		IntensityCodec intensityCodec,
+		double intensityFixedPoint,
+		double ionMobilityFixedPoint
+) {
+	size_t dataSize = mz.size();
+	bool hasIonMobility = !ionMobility.empty();
+
+	if (intensity.size() != dataSize || (hasIonMobility && ionMobility.size() != dataSize))
+		throw "[MSNumpress::encodeSpectrum] All arrays of a spectrum need to be of equal size.";
+
+	result.resize(SPECTRUM_MAX_HEADER_SIZE + dataSize * 15);
+	size_t encodedLength = encodeSpectrum(
+			&mz[0], &intensity[0], hasIonMobility ? &ionMobility[0] : NULL, dataSize,
+			&result[0], mzFixedPoint, intensityCodec, intensityFixedPoint, ionMobilityFixedPoint);
+	result.resize(encodedLength);
+}
+
+
+
+void decodeSpectrum(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &mz,
+		std::vector<double> &intensity,
+		std::vector<double> &ionMobility
+) {
+	size_t dataSize = data.size();
+	size_t count = decodeSpectrumLength(&data[0], dataSize);
+	mz.resize(count);
+	intensity.resize(count);
+	ionMobility.resize(spectrumHasIonMobility(&data[0], dataSize) ? count : 0);
+	decodeSpectrum(&data[0], dataSize, &mz[0], &intensity[0], 
+			ionMobility.empty() ? NULL : &ionMobility[0]);
+}
+
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+void initBlockDecoder(
+		BlockDecoder *decoder,
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		bool complete
+) {
+	decoder->data 		= data;
+	decoder->dataSize 	= dataSize;
+	decoder->complete 	= complete;
+	decoder->finished 	= false;
+	decoder->codec 		= codec;
+	decoder->started 	= codec == BLOCK_PIC;
+	decoder->fixedPoint = 0;
+	decoder->di 		= 0;
+	decoder->half 		= 0;
+	decoder->count 		= 0;
+	decoder->ints[0] 	= 0;
+	decoder->ints[1] 	= 0;
+}
+
+
+
+size_t decodeBlock(
+		BlockDecoder *decoder,
+		double *result,
+		size_t maxValues
+) {
+	const unsigned char *data = decoder->data;
+	size_t dataSize = decoder->dataSize;
+	size_t di = decoder->di;
+	size_t half = decoder->half;
+	size_t ri = 0;
+	unsigned int buff;
+	long long y;
+	
+	if (decoder->finished) return 0;
+	
+	if (!decoder->started) {
+		if (di + 8 > dataSize) {
+			if (decoder->complete) 
+				throw "[MSNumpress::decodeBlock] Corrupt input data: not enough bytes to read fixed point! ";
+			return 0;
+		}
+		decoder->fixedPoint = decodeFixedPoint(&data[di]);
+		decoder->started = true;
+		di += 8;
+	}
+	
+	if (decoder->codec == BLOCK_SLOF) {
+		for (; ri < maxValues && di + 2 <= dataSize; di += 2) {
+			buff = data[di] | (data[di+1] << 8);
+			result[ri++] = exp(buff / decoder->fixedPoint) - 1;
+		}
+		if (decoder->complete && di + 1 == dataSize)
+			throw "[MSNumpress::decodeBlock] Corrupt input data: odd number of Slof bytes! ";
+		
+	} else if (decoder->codec == BLOCK_PIC) {
+		while (ri < maxValues && di < dataSize) {
+			// an int takes at most 9 halfbytes, or 5 bytes from di
+			if (!decoder->complete && di + 5 > dataSize) break;
+			if (di == (dataSize - 1) && half == 1 && (data[di] & 0xf) == 0x0) {
+				di++;
+				break;
+			}
+			decodeInt(data, &di, dataSize, &half, &buff);
+			result[ri++] = static_cast<double>(buff);
+		}
+		
+	} else {
+		while (ri < maxValues && di < dataSize) {
+			if (decoder->count + ri < 2) {
+				if (di + 4 > dataSize) {
+					if (decoder->complete) 
+						throw "[MSNumpress::decodeBlock] Corrupt input data: not enough bytes to read first values! ";
+					break;
+				}
+				y = static_cast<long long>(decodeUInt32(&data[di]));
+				di += 4;
+			} else {
+				if (!decoder->complete && di + 5 > dataSize) break;
+				if (di == (dataSize - 1) && half == 1 && (data[di] & 0xf) == 0x0) {
+					di++;
+					break;
+				}
+				decodeInt(data, &di, dataSize, &half, &buff);
+				y = 2 * decoder->ints[1] - decoder->ints[0] + static_cast<int>(buff);
+			}
+			decoder->ints[0] = decoder->ints[1];
+			decoder->ints[1] = y;
+			result[ri++] = y / decoder->fixedPoint;
+		}
+	}
+	
+	decoder->di = di;
+	decoder->half = half;
+	decoder->count += ri;
+	if (decoder->complete && di >= dataSize && ri < maxValues) 
+		decoder->finished = true;
+	return ri;
+}
+
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+static size_t encodeLinearFixed(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	return encodeLinear(data, dataSize, result, fixedPoint);
+}
+
+
+
+static size_t encodePicFixed(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double
+) {
+	return encodePic(data, dataSize, result);
+}
+
+
+
+static size_t encodeSlofFixed(
+		const double *data, 
+		size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint
+) {
+	return encodeSlof(data, dataSize, result, fixedPoint);
+}
+
+
+
+static size_t decodeLinearSized(
+		const unsigned char *data, 
+		size_t dataSize, 
+		double *result
+) {
+	return decodeLinear(data, dataSize, result);
+}
+
+
+
+static size_t decodePicSized(
+		const unsigned char *data, 
+		size_t dataSize, 
+		double *result
+) {
+	return decodePic(data, dataSize, result);
+}
+
+
+
+/**
+ * decodeSlof with the checks of decodeLinear, as it would read past odd data.
+ */
+static size_t decodeSlofSized(
+		const unsigned char *data, 
+		size_t dataSize, 
+		double *result
+) {
+	if (dataSize % 2 != 0) 
+		throw "[MSNumpress::decodeSlof] Corrupt input data: odd number of bytes! ";
+	return decodeSlof(data, dataSize, result);
+}
+
+
+
+static double optimalPicFixedPoint(
+		const double *, 
+		size_t
+) {
+	return 0;
+}
+
+
+
+static size_t encodeLinearBound(size_t dataSize) { return 8 + dataSize * 5; }
+static size_t encodePicBound(size_t dataSize) { return dataSize * 5; }
+static size_t encodeSlofBound(size_t dataSize) { return 8 + dataSize * 2; }
+
+// every Lin value after the first two takes at least a halfbyte
+static size_t decodeLinearBound(size_t dataSize) { return dataSize <= 16 ? 2 : 2 + (dataSize - 16) * 2; }
+static size_t decodePicBound(size_t dataSize) { return dataSize * 2; }
+static size_t decodeSlofBound(size_t dataSize) { return dataSize < 8 ? 0 : (dataSize - 8) / 2; }
+
+static const CodecDescriptor CODEC_DESCRIPTORS[] = {
+	{ CV_NUMPRESS_LINEAR, ACC_NUMPRESS_LINEAR, 
+			"MS-Numpress linear prediction compression", BLOCK_LINEAR, false,
+			encodeLinearFixed, decodeLinearSized, optimalLinearFixedPoint, encodeLinearBound, decodeLinearBound },
+	{ CV_NUMPRESS_PIC, ACC_NUMPRESS_PIC, 
+			"MS-Numpress positive integer compression", BLOCK_PIC, false,
+			encodePicFixed, decodePicSized, optimalPicFixedPoint, encodePicBound, decodePicBound },
+	{ CV_NUMPRESS_SLOF, ACC_NUMPRESS_SLOF, 
+			"MS-Numpress short logged float compression", BLOCK_SLOF, false,
+			encodeSlofFixed, decodeSlofSized, optimalSlofFixedPoint, encodeSlofBound, decodeSlofBound },
+	{ CV_NUMPRESS_LINEAR_ZLIB, ACC_NUMPRESS_LINEAR_ZLIB, 
+			"MS-Numpress linear prediction compression followed by zlib compression", BLOCK_LINEAR, true,
+			encodeLinearFixed, decodeLinearSized, optimalLinearFixedPoint, encodeLinearBound, decodeLinearBound },
+	{ CV_NUMPRESS_PIC_ZLIB, ACC_NUMPRESS_PIC_ZLIB, 
+			"MS-Numpress positive integer compression followed by zlib compression", BLOCK_PIC, true,
+			encodePicFixed, decodePicSized, optimalPicFixedPoint, encodePicBound, decodePicBound },
+	{ CV_NUMPRESS_SLOF_ZLIB, ACC_NUMPRESS_SLOF_ZLIB, 
+			"MS-Numpress short logged float compression followed by zlib compression", BLOCK_SLOF, true,
+			encodeSlofFixed, decodeSlofSized, optimalSlofFixedPoint, encodeSlofBound, decodeSlofBound }
+};
+
+static const size_t CODEC_DESCRIPTOR_COUNT = sizeof(CODEC_DESCRIPTORS) / sizeof(CODEC_DESCRIPTORS[0]);
+
+
+
+CvCodec resolveCvAccession(
+		const char *accession
+) {
+	if (accession == NULL) return CV_UNKNOWN;
+	for (size_t i=0; i<CODEC_DESCRIPTOR_COUNT; i++) {
+		if (strcmp(accession, CODEC_DESCRIPTORS[i].accession) == 0) 
+			return CODEC_DESCRIPTORS[i].cvCodec;
+	}
+	return CV_UNKNOWN;
+}
+
+
+
+const CodecDescriptor &codecDescriptor(
+		CvCodec cvCodec
+) {
+	for (size_t i=0; i<CODEC_DESCRIPTOR_COUNT; i++) {
+		if (CODEC_DESCRIPTORS[i].cvCodec == cvCodec) 
+			return CODEC_DESCRIPTORS[i];
+	}
+	throw "[MSNumpress::codecDescriptor] Unknown codec.";
+}
+
+
+
+size_t decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result
+) {
+	return codecDescriptor(cvCodec).decode(data, dataSize, result);
+}
+
+
+
+void decode(
+		CvCodec cvCodec,
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result
+) {
+	const CodecDescriptor &descriptor = codecDescriptor(cvCodec);
+	size_t dataSize = data.size();
+	result.resize(descriptor.decodeBound(dataSize));
+	size_t decodedLength = descriptor.decode(&data[0], dataSize, &result[0]);
+	result.resize(decodedLength);
+}
+
+
+
+/**
+ * Number of arrays ahead of the current one whose first PREFETCH_BYTES 
+ * the batch decoders prefetch, so that the cache misses on the header and 
+ * first values of scattered arrays overlap with decoding.
+ */
+static const size_t PREFETCH_ARRAYS = 4;
+static const size_t PREFETCH_BYTES 	= 128;
+
+static void prefetchArray(
+		const unsigned char *data,
+		size_t dataSize
+) {
+#if defined(__GNUC__)
+	size_t n = min(dataSize, PREFETCH_BYTES);
+	for (size_t b=0; b<n; b+=64) {
+		__builtin_prefetch(data + b);
+	}
+#else
+	(void)data;
+	(void)dataSize;
+#endif
+}
+
+
+
+/**
+ * Prefetches the array PREFETCH_ARRAYS ahead of array i of a batch, and 
+ * before the first array also the ones in between, so that every array is
+ * prefetched once, PREFETCH_ARRAYS arrays before it is decoded.
+ */
+static void prefetchAhead(
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		size_t i
+) {
+	size_t p;
+	if (i == 0) {
+		for (p=0; p<PREFETCH_ARRAYS && p<count; p++) {
+			prefetchArray(data[p], dataSizes[p]);
+		}
 	}
-	
-	return ri;
+	if (i + PREFETCH_ARRAYS < count) 
+		prefetchArray(data[i + PREFETCH_ARRAYS], dataSizes[i + PREFETCH_ARRAYS]);
 }
 
-/////////////////////////////////////////////////////////////
 
 
-size_t encodePic(
-		const double *data, 
-		size_t dataSize, 
-		unsigned char *result
+size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets
 ) {
-	size_t i, ri;
-	unsigned int x;
-	unsigned char halfBytes[10];
-	size_t halfByteCount;
-	size_t hbi;
+	size_t (*decodeArray)(const unsigned char *, size_t, double *) = codecDescriptor(cvCodec).decode;
 
-	//printf("Encoding %d doubles\n", (int)dataSize);
+	offsets[0] = 0;
+	for (size_t i=0; i<count; i++) {
+		prefetchAhead(data, dataSizes, count, i);
+		offsets[i+1] = offsets[i] + decodeArray(data[i], dataSizes[i], result + offsets[i]);
+	}
+	return offsets[count];
+}
 
-	halfByteCount = 0;
-	ri = 0;
 
-	for (i=0; i<dataSize; i++) {
-		
-		if (THROW_ON_OVERFLOW && 
-				(data[i] + 0.5 > INT_MAX || data[i] < -0.5)		){
-			throw "[MSNumpress::encodePic] Cannot use Pic to encode a number larger than INT_MAX or smaller than 0.";
-		}
-		x = static_cast<unsigned int>(data[i] + 0.5);
-		//printf("%d %d %d,   extrapol: %d    diff: %d \n", ints[0], ints[1], ints[2], extrapol, diff);
-		encodeInt(x, &halfBytes[halfByteCount], &halfByteCount);
-		
-		for (hbi=1; hbi < halfByteCount; hbi+=2) {
-			result[ri] = static_cast<unsigned char>(
-					(halfBytes[hbi-1] << 4) | (halfBytes[hbi] & 0xf)
-				);
-			//printf("%x \n", result[ri]);
-			ri++;
-		}
-		if (halfByteCount % 2 != 0) {
-			halfBytes[0] = halfBytes[halfByteCount-1];
-			halfByteCount = 1;
-		} else {
-			halfByteCount = 0;
-		}
+
+size_t decodeBatch(
+		const CvCodec *cvCodecs,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets
+) {
+	offsets[0] = 0;
+	for (size_t i=0; i<count; i++) {
+		prefetchAhead(data, dataSizes, count, i);
+		offsets[i+1] = offsets[i] + codecDescriptor(cvCodecs[i]).decode(data[i], dataSizes[i], result + offsets[i]);
 	}
-	if (halfByteCount == 1) {
-		result[ri] = static_cast<unsigned char>(halfBytes[0] << 4);
-		ri++;
+	return offsets[count];
+}
+
+
+
+/**
+ * Copies count doubles from block to result with non-temporal stores, 
+ * storing a double before and after the 16 byte aligned part of result 
+ * normally. The stores need an sfence before result is read by another 
+ * thread.
+ */
+static void streamDoubles(
+		const double *block,
+		size_t count,
+		double *result
+) {
+#ifdef __SSE2__
+	size_t i = 0;
+	if ((reinterpret_cast<size_t>(result) & 7) != 0) {
+		memcpy(result, block, count * sizeof(double));
+		return;
 	}
-	return ri;
+	if ((reinterpret_cast<size_t>(result) & 15) != 0 && count > 0) {
+		result[0] = block[0];
+		i = 1;
+	}
+	for (; i + 2 <= count; i += 2) {
+		_mm_stream_pd(&result[i], _mm_loadu_pd(&block[i]));
+	}
+	if (i < count) result[i] = block[i];
+#else
+	memcpy(result, block, count * sizeof(double));
+#endif
 }
 
 
 
-size_t decodePic(
+/**
+ * Decodes data into result through block, a buffer of STREAM_BUFFER_SIZE 
+ * values copied with streamDoubles. Arrays that fit are decoded with the 
+ * whole array decoder, larger ones block by block.
+ */
+static size_t decodeStreamed(
+		const CodecDescriptor &descriptor,
 		const unsigned char *data,
-		const size_t dataSize,
-		double *result
+		size_t dataSize,
+		double *result,
+		double *block
 ) {
-	size_t ri;
-	unsigned int x;
-	size_t di;
-	size_t half;
+	BlockDecoder decoder;
+	size_t count;
+	size_t total = 0;
+
+	if (descriptor.decodeBound(dataSize) <= STREAM_BUFFER_SIZE) {
+		count = descriptor.decode(data, dataSize, block);
+		streamDoubles(block, count, result);
+		return count;
+	}
 
-	//printf("ri      di      half    dSize   count\n");
-	
-	half = 0;
-	ri = 0;
-	di = 0;
-	
-	while (di < dataSize) {
-		if (di == (dataSize - 1) && half == 1) {
-			if ((data[di] & 0xf) == 0x0) {
-				break;
-			}
-		}
-		
-		decodeInt(&data[0], &di, dataSize, &half, &x);
-		
-		//printf("%7d %7d %7d %7d %7d\n", ri, di, half, dataSize, count);
-		
-		//printf("count: %d \n", count);
-		result[ri++] = static_cast<double>(x);
+	initBlockDecoder(&decoder, descriptor.codec, data, dataSize, true);
+	while ((count = decodeBlock(&decoder, block, STREAM_BUFFER_SIZE)) > 0) {
+		streamDoubles(block, count, result + total);
+		total += count;
 	}
+	return total;
+}
 
-	return ri;
+
+
+/**
+ * Orders the non-temporal stores of streamDoubles before later stores.
+ */
+static void streamFence() {
+#ifdef __SSE2__
+	_mm_sfence();
+#endif
 }
 
 
 
-void encodePic(
-		const std::vector<double> &data,  
-		std::vector<unsigned char> &result
+size_t decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result,
+		size_t streamingThreshold,
+		double *buffer
 ) {
-	size_t dataSize = data.size();
-	result.resize(dataSize * 5);
-	size_t encodedLength = encodePic(&data[0], dataSize, &result[0]);
-	result.resize(encodedLength);
+	const CodecDescriptor &descriptor = codecDescriptor(cvCodec);
+	std::vector<double> allocated;
+	size_t count;
+
+	if (streamingThreshold == 0 || 
+			descriptor.decodeBound(dataSize) * sizeof(double) < streamingThreshold)
+		return descriptor.decode(data, dataSize, result);
+
+	if (buffer == NULL) {
+		allocated.resize(STREAM_BUFFER_SIZE);
+		buffer = &allocated[0];
+	}
+	count = decodeStreamed(descriptor, data, dataSize, result, buffer);
+	streamFence();
+	return count;
 }
 
 
 
-void decodePic(
-		const std::vector<unsigned char> &data,  
-		std::vector<double> &result
+size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets,
+		size_t streamingThreshold,
+		double *buffer
 ) {
-	size_t dataSize = data.size();
-	result.resize(dataSize * 2);
-	size_t decodedLength = decodePic(&data[0], dataSize, &result[0]);
-	result.resize(decodedLength);
+	const CodecDescriptor &descriptor = codecDescriptor(cvCodec);
+	std::vector<double> allocated;
+	size_t i, bound;
+
+	for (i=0, bound=0; i<count; i++) {
+		bound += descriptor.decodeBound(dataSizes[i]);
+	}
+	if (streamingThreshold == 0 || bound * sizeof(double) < streamingThreshold)
+		return decodeBatch(cvCodec, data, dataSizes, count, result, offsets);
+
+	if (buffer == NULL) {
+		allocated.resize(STREAM_BUFFER_SIZE);
+		buffer = &allocated[0];
+	}
+	offsets[0] = 0;
+	for (i=0; i<count; i++) {
+		prefetchAhead(data, dataSizes, count, i);
+		offsets[i+1] = offsets[i] + decodeStreamed(descriptor, data[i], dataSizes[i], 
+				result + offsets[i], buffer);
+	}
+	streamFence();
+	return offsets[count];
 }
 
 
+
 /////////////////////////////////////////////////////////////
 
+double linearFixedPointForBounds(
+		double maxValue,
+		double maxStep
+) {
+	// the largest residual of the linear prediction is 2 * maxStep, plus
+	// rounding, and the first two values are stored as they are
+	double maxDouble = max(maxValue, ceil(2 * maxStep) + 1);
+	return floor(0x7FFFFFFFl / max(maxDouble, 1.0));
+}
 
-double optimalSlofFixedPoint(
-		const double *data, 
-		size_t dataSize
+
+
+double slofFixedPointForBounds(
+		double maxValue
 ) {
-	if (dataSize == 0) return 0;
-	
-	double maxDouble = 1;
-	double x;
-	double fp;
+	return floor(0xFFFF / max(log(max(maxValue, 0.0) + 1), 1.0));
+}
 
-	for (size_t i=0; i<dataSize; i++) {
-		x = log(data[i]+1);
-		maxDouble = max(maxDouble, x);
+
+
+void initRealtimeEncoder(
+		RealtimeEncoder *encoder,
+		BlockCodec codec,
+		double maxValue,
+		double maxStep
+) {
+	encoder->codec = codec;
+	encoder->maxValue = maxValue;
+	if (codec == BLOCK_LINEAR) {
+		encoder->fixedPoint = linearFixedPointForBounds(maxValue, maxStep);
+	} else if (codec == BLOCK_SLOF) {
+		encoder->fixedPoint = slofFixedPointForBounds(maxValue);
+	} else {
+		encoder->fixedPoint = 0;
 	}
+}
 
-	fp = floor(0xFFFF / maxDouble);
 
-	//cout << "    max val: " << maxDouble << endl;
-	//cout << "fixed point: " << fp << endl;
 
-	return fp;
+size_t realtimeEncodeBound(
+		BlockCodec codec,
+		size_t dataSize
+) {
+	if (codec == BLOCK_LINEAR) 	return 8 + dataSize * 5;
+	if (codec == BLOCK_PIC) 	return dataSize * 5;
+	return 8 + dataSize * 2;
 }
 
 
 
-size_t encodeSlof(
-		const double *data, 
-		size_t dataSize, 
-		unsigned char *result,
-		double fixedPoint
+/**
+ * x within [0, maxValue], counting values that are not (including NaN).
+ */
+static inline double saturate(
+		double x,
+		double maxValue,
+		size_t *clamped
 ) {
-	size_t i, ri;
-	double temp;
-	unsigned short x;
-	encodeFixedPoint(fixedPoint, result);
+	if (x >= 0 && x <= maxValue) return x;
+	(*clamped)++;
+	return x > maxValue ? maxValue : 0;
+}
 
-	ri = 8;
-	for (i=0; i<dataSize; i++) {
-		temp = log(data[i]+1) * fixedPoint;
 
-		if (THROW_ON_OVERFLOW && 
-				temp > USHRT_MAX		) {
-			throw "[MSNumpress::encodeSlof] Cannot encode a number that overflows USHRT_MAX.";
-		}
 
-		x = static_cast<unsigned short>(temp + 0.5);
-		result[ri++] = x & 0xff;
-		result[ri++] = (x >> 8) & 0xff; 
-	}
-	return ri;
+/**
+ * Number of leading 0x0 halfbytes of x, 8 for 0.
+ */
+static inline unsigned int leadingZeroHalfBytes(
+		unsigned int x
+) {
+#if defined(__GNUC__)
+	return x == 0 ? 8 : static_cast<unsigned int>(__builtin_clz(x)) / 4;
+#else
+	unsigned int n = 0;
+	for (unsigned int m = 0xf0000000; m != 0 && (x & m) == 0; m >>= 4) n++;
+	return n;
+#endif
 }
 
 
 
-size_t decodeSlof(
-		const unsigned char *data, 
-		const size_t dataSize, 
-		double *result
+/**
+ * Writes the halfbytes of encodeInt(x) to result from halfbyte *hbi on, 
+ * without data dependent branches: the 9 halfbytes an int may need are 
+ * written as 5 bytes, and *hbi is advanced by the length of x. Halfbytes 
+ * beyond that are overwritten by the next int, or cleared at the end.
+ */
+static inline void writeIntHalfBytes(
+		unsigned int x,
+		unsigned char *result,
+		size_t *hbi
 ) {
-	size_t i, ri;
-	unsigned short x;
-	double fixedPoint;
-
-	if (dataSize < 8) 
-		throw "[MSNumpress::decodeSlof] Corrupt input data: not enough bytes to read fixed point! ";
+	unsigned int ones = (x >> 28) == 0xf;
+	unsigned int l = leadingZeroHalfBytes(ones ? ~x : x);
+	l = ones && l > 7 ? 7 : l;
 	
-	ri = 0;
-	fixedPoint = decodeFixedPoint(data);
-
-	for (i=8; i<dataSize; i+=2) {
-		x = static_cast<unsigned short>(data[i] | (data[i+1] << 8));
-		result[ri++] = exp(x / fixedPoint) - 1;
-	}
-	return ri;
+	// the halfbyte stream from the least significant halfbyte on, after the 
+	// halfbyte already in the first byte if *hbi is odd
+	size_t odd = *hbi & 1;
+	unsigned char *bytes = &result[*hbi >> 1];
+	unsigned long long v = (l + 8 * ones) | (static_cast<unsigned long long>(x) << 4);
+	v = (v << (4 * odd)) | ((bytes[0] >> 4) & (0 - odd));
+	// stream order puts the first halfbyte of each byte in its high bits
+	v = ((v & 0x0f0f0f0f0f0f0f0fULL) << 4) | ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL);
+	
+	bytes[0] = static_cast<unsigned char>(v);
+	bytes[1] = static_cast<unsigned char>(v >> 8);
+	bytes[2] = static_cast<unsigned char>(v >> 16);
+	bytes[3] = static_cast<unsigned char>(v >> 24);
+	bytes[4] = static_cast<unsigned char>(v >> 32);
+	*hbi += 9 - l;
 }
 
 
 
-void encodeSlof(
-		const std::vector<double> &data,  
-		std::vector<unsigned char> &result,
-		double fixedPoint
+/**
+ * Clears the padding halfbyte after hbi halfbytes written by 
+ * writeIntHalfBytes, returning the number of bytes.
+ */
+static inline size_t endHalfBytes(
+		unsigned char *result,
+		size_t hbi
 ) {
-	size_t dataSize = data.size();
-	result.resize(dataSize * 2 + 8);
-	size_t encodedLength = encodeSlof(&data[0], dataSize, &result[0], fixedPoint);
-	result.resize(encodedLength);
+	if (hbi % 2 != 0) {
+		result[hbi >> 1] &= 0xf0;
+	}
+	return (hbi + 1) / 2;
 }
 
 
 
-void decodeSlof(
-		const std::vector<unsigned char> &data,  
-		std::vector<double> &result
+size_t encodeRealtime(
+		const RealtimeEncoder *encoder,
+		const double *data,
+		size_t dataSize,
+		unsigned char *result,
+		size_t resultCapacity,
+		size_t *clamped
 ) {
-	size_t dataSize = data.size();
-	result.resize((dataSize - 8) / 2);
-	size_t decodedLength = decodeSlof(&data[0], dataSize, &result[0]);
-	result.resize(decodedLength);
+	size_t i, j, ri = 0, hbi;
+	size_t saturated = 0;
+	double fixedPoint = encoder->fixedPoint;
+	double maxValue = encoder->maxValue;
+	long long ints[3], extrapol, diff;
+	double temp;
+	unsigned short x;
+
+	if (clamped != NULL) *clamped = 0;
+	if (resultCapacity < realtimeEncodeBound(encoder->codec, dataSize)) 
+		return 0;
+	if (encoder->codec != BLOCK_PIC && !(fixedPoint > 0))
+		return 0;
+
+	if (encoder->codec == BLOCK_LINEAR) {
+		// keep the first values within their 4 bytes
+		maxValue = min(maxValue, 0x7FFFFFFFl / fixedPoint);
+		encodeFixedPoint(fixedPoint, result);
+		ri = 8;
+
+		for (i=0; i<dataSize && i<2; i++) {
+			ints[i+1] = static_cast<long long>(saturate(data[i], maxValue, &saturated) * fixedPoint + 0.5);
+			for (j=0; j<4; j++) {
+				result[ri++] = (ints[i+1] >> (j*8)) & 0xff;
+			}
+		}
+		hbi = 2 * ri;
+		for (i=2; i<dataSize; i++) {
+			ints[0] = ints[1];
+			ints[1] = ints[2];
+			ints[2] = static_cast<long long>(saturate(data[i], maxValue, &saturated) * fixedPoint + 0.5);
+			extrapol = ints[1] + (ints[1] - ints[0]);
+			diff = ints[2] - extrapol;
+			if (diff > INT_MAX || diff < INT_MIN) {
+				// continue from the value the decoder will see
+				diff = diff > INT_MAX ? INT_MAX : INT_MIN;
+				ints[2] = extrapol + diff;
+				saturated++;
+			}
+			writeIntHalfBytes(static_cast<unsigned int>(diff), result, &hbi);
+		}
+		if (dataSize > 2) {
+			ri = endHalfBytes(result, hbi);
+		}
+
+	} else if (encoder->codec == BLOCK_PIC) {
+		maxValue = min(maxValue, INT_MAX - 0.5);
+		hbi = 0;
+		for (i=0; i<dataSize; i++) {
+			writeIntHalfBytes(
+					static_cast<unsigned int>(saturate(data[i], maxValue, &saturated) + 0.5), 
+					result, 
+					&hbi
+				);
+		}
+		ri = endHalfBytes(result, hbi);
+
+	} else {
+		encodeFixedPoint(fixedPoint, result);
+		ri = 8;
+		for (i=0; i<dataSize; i++) {
+			temp = fastLog(saturate(data[i], maxValue, &saturated) + 1) * fixedPoint;
+			if (!(temp <= USHRT_MAX)) {
+				temp = USHRT_MAX;
+				saturated++;
+			}
+			x = static_cast<unsigned short>(temp + 0.5);
+			result[ri++] = x & 0xff;
+			result[ri++] = (x >> 8) & 0xff;
+		}
+	}
+
+	if (clamped != NULL) *clamped = saturated;
+	return ri;
 }
 
 }
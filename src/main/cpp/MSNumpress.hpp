@@ -128,7 +128,106 @@ namespace MSNumpress {
 	void decodeLinear(
 		const std::vector<unsigned char> &data,
 		std::vector<double> &result);
-		
+
+	/**
+	 * Returns optimalLinearFixedPoint rounded down to a power of ten. Evenly
+	 * spaced data only gives zero residuals if the step times the fixed point
+	 * is an integer, which a decimal fixed point ensures for the decimal steps
+	 * of typical retention time and resampled m/z grids.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @return		the fixed point to use with encodeLinearRuns
+	 */
+	double optimalLinearRunsFixedPoint(
+		const double *data,
+		size_t dataSize);
+
+	/**
+	 * Same as encodeLinear, but runs of at least 10 consecutive zero residuals
+	 * (evenly spaced values, as in regular retention time or resampled m/z grids)
+	 * are replaced by a single run token. A run token is a 0x0 count halfbyte
+	 * followed by 8 halfbytes holding the run length with a most significant
+	 * halfbyte of 0x0, a combination encodeInt never produces.
+	 *
+	 * Without runs the output is identical to encodeLinear. With runs, the
+	 * output must be decoded by decodeLinearRuns, as decodeLinear would
+	 * read each run token as a single residual.
+	 *
+	 * The resulting binary is maximally 8 + dataSize * 5 bytes.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to where resulting bytes should be stored
+	 * @fixedPoint	the scaling factor used for getting the fixed point repr.
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeLinearRuns(
+		const double *data,
+		const size_t dataSize,
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Calls lower level encodeLinearRuns while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodeLinearRuns(
+		const std::vector<double> &data,
+		std::vector<unsigned char> &result,
+		double fixedPoint);
+
+	/**
+	 * Counts the doubles that decodeLinearRuns will produce from data, without
+	 * decoding them. Since a run token expands to up to 2^28 - 1 values, this is
+	 * needed for sizing the result of decodeLinearRuns.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @return		the number of doubles encoded in data
+	 */
+	size_t decodeLinearRunsLength(
+		const unsigned char *data,
+		const size_t dataSize);
+
+	/**
+	 * Decodes data encoded by encodeLinearRuns or encodeLinear. Run tokens are
+	 * expanded with a branch free arithmetic progression fill. Data taking 
+	 * the fixed point ints beyond 2^60 in magnitude, which no encoder writes, 
+	 * is deemed corrupt, so runs cannot overflow.
+	 *
+	 * result must hold at least decodeLinearRunsLength(data, dataSize) doubles.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeLinearRuns(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result);
+
+	/**
+	 * Calls lower level decodeLinearRuns while handling vector sizes appropriately.
+	 * Decodes in one pass, into a result sized for data without run tokens
+	 * and enlarged by the runs it meets.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		vector of bytes to be decoded
+	 * @result		vector of resulting double (will be resized to the number of doubles)
+	 */
+	void decodeLinearRuns(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
 /////////////////////////////////////////////////////////////
 	
 	
@@ -166,6 +265,67 @@ namespace MSNumpress {
 		const unsigned char *data,
 		const size_t dataSize,
 		double *result);
+
+	/**
+	 * Transposes dataSize elements of elementSize bytes into elementSize planes
+	 * of dataSize bytes, so that plane j holds byte j of every element. This 
+	 * exposes the redundancy of e.g. the high bytes of doubles to zlib, like 
+	 * the blosc shuffle filter. 8 byte elements use an SSE2 kernel when available.
+	 *
+	 * @data			pointer to dataSize * elementSize bytes to shuffle
+	 * @dataSize		number of elements
+	 * @elementSize		number of bytes per element
+	 * @result			pointer to were the dataSize * elementSize shuffled bytes should be stored
+	 */
+	void shuffleBytes(
+		const unsigned char *data,
+		const size_t dataSize,
+		const size_t elementSize,
+		unsigned char *result);
+
+	/**
+	 * Reverses shuffleBytes.
+	 *
+	 * @data			pointer to dataSize * elementSize shuffled bytes
+	 * @dataSize		number of elements
+	 * @elementSize		number of bytes per element
+	 * @result			pointer to were the dataSize * elementSize bytes should be stored
+	 */
+	void unshuffleBytes(
+		const unsigned char *data,
+		const size_t dataSize,
+		const size_t elementSize,
+		unsigned char *result);
+
+	/**
+	 * Same as encodeSafe, but with the 8 bytes of each stored double in 
+	 * separate planes as by shuffleBytes, which compresses better and faster 
+	 * with zlib. The output must be decoded by decodeSafeShuffled.
+	 *
+	 * @data		pointer to array of doubles to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to were resulting bytes should be stored
+	 * @return		the number of encoded bytes, dataSize * 8
+	 */
+	size_t encodeSafeShuffled(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result);
+
+	/**
+	 * Decodes data encoded by encodeSafeShuffled.
+	 *
+	 * Might throw const char* is something goes wrong during decoding.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeSafeShuffled(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result);
 	
 /////////////////////////////////////////////////////////////
 
@@ -230,6 +390,76 @@ namespace MSNumpress {
 		const std::vector<unsigned char> &data,
 		std::vector<double> &result);
 
+	/**
+	 * Encodes ion counts by rounding a fixed point representation of their
+	 * square root to the nearest 4 byte integer, and compressing each integer 
+	 * with encodeInt. This is calculated as
+	 *
+	 * unsigned int q = sqrt(d) * fixedPoint + 0.5
+	 *
+	 * The square root stabilizes the variance of Poisson distributed counts, 
+	 * so the decoded error |d' - d| <= sqrt(d) / fixedPoint + 1 / (4 * fixedPoint^2)
+	 * stays within 1 / fixedPoint standard deviations of the counting noise 
+	 * for every intensity, while high intensities take far fewer halfbytes 
+	 * than with encodePic. Zero is encoded exactly.
+	 *
+	 * The fixed point is stored first as an 8 byte double. The resulting binary
+	 * is maximally 8 + dataSize * 5 bytes.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to were resulting bytes should be stored
+	 * @fixedPoint	the scaling factor, e.g. 2 for an error of at most half a
+	 *				standard deviation
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodePicSqrt(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Calls lower level encodePicSqrt while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodePicSqrt(
+		const std::vector<double> &data,
+		std::vector<unsigned char> &result,
+		double fixedPoint);
+
+	/**
+	 * Decodes data encoded by encodePicSqrt. The integers are decoded first,
+	 * and then scaled and squared in a separate, vectorizable pass.
+	 *
+	 * result vector guaranteed to be shorter or equal to (|data| - 8) * 2
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodePicSqrt(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result);
+
+	/**
+	 * Calls lower level decodePicSqrt while handling vector sizes appropriately
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		vector of bytes to be decoded
+	 * @result		vector of resulting double (will be resized to the number of doubles)
+	 */
+	void decodePicSqrt(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
 /////////////////////////////////////////////////////////////
 
 
@@ -267,6 +497,40 @@ namespace MSNumpress {
 		std::vector<unsigned char> &result,
 		double fixedPoint);
 
+	/**
+	 * Same as encodeSlof, but computing the logarithms with a vectorizable 
+	 * approximation with a relative error below 1e-10, far below half a 
+	 * quantization step. The logarithms of groups of 4 values are taken in
+	 * a loop that GCC vectorizes from -O2, with only the last group padded,
+	 * so short arrays cost no more than their own values. With SSE2 this 
+	 * makes encoding about 1.6 times faster than encodeSlof (see "slof fast"
+	 * in MSNumpressBench). The output matches encodeSlof except for values 
+	 * within 1e-10 of a rounding boundary, which may round to the neighbouring
+	 * short. Input values need to be finite and non-negative.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to were resulting bytes should be stored
+	 * @fixedPoint	the scaling factor, as from optimalSlofFixedPoint
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeSlofFast(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Calls lower level encodeSlofFast while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodeSlofFast(
+		const std::vector<double> &data,
+		std::vector<unsigned char> &result,
+		double fixedPoint);
+
 	/**
 	 * Decodes data encoded by encodeSlof
 	 *
@@ -296,6 +560,936 @@ namespace MSNumpress {
 		const std::vector<unsigned char> &data,
 		std::vector<double> &result);
 
+	/**
+	 * Decodes data encoded by encodeSlof into the natural logarithm of the
+	 * ion counts plus one, i.e. x / fixedPoint, skipping the exp.
+	 *
+	 * The return will include exactly (|data| - 8) / 2 doubles.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting log values should be stored
+	 * @return		the number of decoded values
+	 */
+	size_t decodeSlofLog(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result);
+
+	/**
+	 * Calls lower level decodeSlofLog while handling vector sizes appropriately
+	 */
+	void decodeSlofLog(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
+	/**
+	 * Decodes data encoded by encodeSlof into IEEE 754 half precision floats,
+	 * stored as their bit patterns, scaled by 2^-exponent so that every value 
+	 * the fixed point can store fits in half range: value = half * 2^exponent.
+	 * The exponent depends only on the fixed point, and is the smallest one,
+	 * but at least -64, that fits e^(65535/fixedPoint) - 1 under 65504, so 
+	 * blocks with the same fixed point share it. Scaled values are computed 
+	 * in double with a vectorizable exp, rounded to float, and then to half 
+	 * precision, using F16C instructions when compiled with them (e.g. 
+	 * -mf16c) and an equivalent scalar conversion otherwise, for a relative 
+	 * error within 2^-11 above the half subnormal range.
+	 *
+	 * The return will include exactly (|data| - 8) / 2 values.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data 
+	 * to be corrupt, or if the fixed point is below 65535/700, as its largest 
+	 * value would overflow a double.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting half floats should be stored
+	 * @exponent	pointer to where the power of two to scale them by should be stored
+	 * @return		the number of decoded values
+	 */
+	size_t decodeSlofHalf(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		unsigned short *result,
+		int *exponent);
+
+	/**
+	 * Calls lower level decodeSlofHalf while handling vector sizes appropriately
+	 */
+	void decodeSlofHalf(
+		const std::vector<unsigned char> &data,
+		std::vector<unsigned short> &result,
+		int *exponent);
+
+	/**
+	 * Same as encodeSlof, but with all low bytes of the stored shorts 
+	 * followed by all high bytes, after the 8 byte fixed point, which 
+	 * compresses better and faster with zlib. The output must be decoded by 
+	 * decodeSlofShuffled.
+	 *
+	 * the result vector is exactly |data| * 2 + 8 bytes long
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to were resulting bytes should be stored
+	 * @fixedPoint	the scaling factor, as from optimalSlofFixedPoint
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeSlofShuffled(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Decodes data encoded by encodeSlofShuffled
+	 *
+	 * The return will include exactly (|data| - 8) / 2 doubles.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeSlofShuffled(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result);
+
+	/**
+	 * Encodes ion counts of profile spectra by quantizing the natural logarithm
+	 * exactly as encodeSlof does, and then storing the residuals from a linear
+	 * prediction of each quantized value from the two previous ones, encoded
+	 * by encodeInt. Profile peaks are roughly gaussian, so their logarithms
+	 * are roughly quadratic and well predicted.
+	 *
+	 * The first value is predicted as 0, and the second as the first value. 
+	 * The fixed point is stored first as an 8 byte double.
+	 *
+	 * The resulting binary is maximally 9 + dataSize * 5 bytes, but typically
+	 * much less than the |data| * 2 + 8 bytes of encodeSlof.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to were resulting bytes should be stored
+	 * @fixedPoint	the scaling factor, as from optimalSlofFixedPoint
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeSlofLinear(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Calls lower level encodeSlofLinear while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodeSlofLinear(
+		const std::vector<double> &data,
+		std::vector<unsigned char> &result,
+		double fixedPoint);
+
+	/**
+	 * Decodes data encoded by encodeSlofLinear, giving the same values as
+	 * decodeSlof on data encoded by encodeSlof with the same fixed point.
+	 * Exponentials are kept on the stack in a table of 1024 slots, indexed 
+	 * by the low bits of the quantized value, and reused while not replaced,
+	 * which spares most exp calls on profiles.
+	 *
+	 * result vector guaranteed to be shorter or equal to (|data| - 8) * 2
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeSlofLinear(
+		const unsigned char *data, 
+		const size_t dataSize, 
+		double *result);
+
+	/**
+	 * Calls lower level decodeSlofLinear while handling vector sizes appropriately
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		vector of bytes to be decoded
+	 * @result		vector of resulting double (will be resized to the number of doubles)
+	 */
+	void decodeSlofLinear(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
+/////////////////////////////////////////////////////////////
+
+
+	/**
+	 * Returns the largest fixed point for which encodeStep can store the 
+	 * first run value and the residuals of the linear prediction of every 
+	 * further run value from the two previous ones as 4 byte ints. Values 
+	 * are merged into runs by exact equality here, so repeated values that 
+	 * only become equal after rounding to the fixed point can only lower the
+	 * residuals.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @return		the fixed point to use with encodeStep, 0 for no data
+	 */
+	double optimalStepFixedPoint(
+		const double *data, 
+		size_t dataSize);
+
+	/**
+	 * Encodes piecewise constant data, like ion mobility arrays where many 
+	 * consecutive peaks share a value, as (value, run length) pairs after
+	 *   - lossy conversion to a 4 byte fixed point representation
+	 *   - merging consecutive values with the same fixed point representation 
+	 *     into runs
+	 *   - storing the residuals from a linear prediction of each run value from 
+	 *     the two previous run values
+	 *   - encoding residual and run length - 1 of each run by encodeInt
+	 *
+	 * The fixed point is stored as 8 bytes, followed by the number of values 
+	 * as a 4 byte little-endian integer, and the encodeInt halfbytes.
+	 *
+	 * The resulting binary is maximally 13 + dataSize * 9 bytes, but much less 
+	 * if runs are long.
+	 *
+	 * @data		pointer to array of double to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to where resulting bytes should be stored
+	 * @fixedPoint	the scaling factor used for getting the fixed point repr. 
+	 * 				This is stored in the binary and automatically extracted
+	 * 				on decoding.
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeStep(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double fixedPoint);
+
+	/**
+	 * Calls lower level encodeStep while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodeStep(
+		const std::vector<double> &data, 
+		std::vector<unsigned char> &result,
+		double fixedPoint);
+
+	/**
+	 * Reads the number of doubles encoded by encodeStep from the header.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @return		the number of encoded doubles
+	 */
+	size_t decodeStepLength(
+		const unsigned char *data,
+		const size_t dataSize);
+
+	/**
+	 * Decodes data encoded by encodeStep, filling each run with a single value.
+	 *
+	 * result must hold decodeStepLength(data, dataSize) doubles, which are
+	 * never exceeded even for corrupt input.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeStep(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result);
+
+	/**
+	 * Calls lower level decodeStep while handling vector sizes appropriately
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		vector of bytes to be decoded
+	 * @result		vector of resulting double (will be resized to the number of doubles)
+	 */
+	void decodeStep(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
+/////////////////////////////////////////////////////////////
+
+
+	/**
+	 * Encodes raw time-of-flight m/z values, which are a calibration function
+	 * m/z = (a * t + b)^2 of an integer detector time bin t, by storing only the 
+	 * time bins. These are encoded by encodeLinearRuns with a fixed point of 1, 
+	 * which is left out, so that contiguous bins of profile data collapse into
+	 * run tokens.
+	 *
+	 * Every value is checked to be reconstructed from its time bin to within 
+	 * tolerance. If any value misses, or a bin falls outside 0 <= t < 2^30,
+	 * the data is instead encoded by encodeLinear with optimalLinearFixedPoint.
+	 *
+	 * The first byte holds the mode, 0 for time bins or 1 for the Linear fallback, 
+	 * followed by the number of values as a 4 byte little-endian integer, the 
+	 * calibration coefficients a and b as 8 byte doubles if mode is 0, and the 
+	 * Linear binary, without its fixed point if mode is 0.
+	 *
+	 * The resulting binary is maximally 21 + dataSize * 5 bytes.
+	 *
+	 * @data		pointer to array of m/z values to be encoded (need memorycont. repr.)
+	 * @dataSize	number of doubles from *data to encode
+	 * @result		pointer to where resulting bytes should be stored
+	 * @a			calibration slope, m/z = (a * t + b)^2
+	 * @b			calibration intercept
+	 * @tolerance	maximal absolute m/z error for using the time bins
+	 * @return		the number of encoded bytes
+	 */
+	size_t encodeCalibrated(
+		const double *data, 
+		const size_t dataSize, 
+		unsigned char *result,
+		double a,
+		double b,
+		double tolerance);
+
+	/**
+	 * Calls lower level encodeCalibrated while handling vector sizes appropriately
+	 *
+	 * @data		vector of doubles to be encoded
+	 * @result		vector of resulting bytes (will be resized to the number of bytes)
+	 */
+	void encodeCalibrated(
+		const std::vector<double> &data, 
+		std::vector<unsigned char> &result,
+		double a,
+		double b,
+		double tolerance);
+
+	/**
+	 * Reads the number of doubles encoded by encodeCalibrated from the header.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 */
+	size_t decodeCalibratedLength(
+		const unsigned char *data,
+		const size_t dataSize);
+
+	/**
+	 * Decodes data encoded by encodeCalibrated. Time bins are decoded into 
+	 * result and converted to m/z in place.
+	 *
+	 * result must hold decodeCalibratedLength(data, dataSize) doubles, which are
+	 * never exceeded even for corrupt input.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @result		pointer to were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeCalibrated(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *result);
+
+	/**
+	 * Calls lower level decodeCalibrated while handling vector sizes appropriately
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		vector of bytes to be decoded
+	 * @result		vector of resulting double (will be resized to the number of doubles)
+	 */
+	void decodeCalibrated(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
+/////////////////////////////////////////////////////////////
+
+	/**
+	 * Codecs available for the intensity array of a spectrum block.
+	 */
+	enum IntensityCodec {
+		INTENSITY_SLOF 	= 0,
+		INTENSITY_PIC 	= 1
+	};
+
+	/**
+	 * Encodes the arrays of one spectrum into a single block, with one shared 
+	 * header holding the number of peaks, the intensity codec and the fixed 
+	 * points, followed by
+	 *   - the m/z array encoded by encodeLinear
+	 *   - the intensity array encoded by encodeSlof or encodePic
+	 *   - optionally the ion mobility array encoded by encodeLinear
+	 * where the sections leave out the fixed points, which are in the header.
+	 *
+	 * Header layout:
+	 *
+	 *	1-5 bytes	varint (7 bits per byte, least significant first) of the 
+	 *				number of peaks * 4 + flags, where bit 0 is the 
+	 *				IntensityCodec and bit 1 marks ion mobility
+	 *	4 bytes		m/z fixed point
+	 *	4 bytes		intensity fixed point, for INTENSITY_SLOF only
+	 *	4 bytes		ion mobility fixed point, with ion mobility only
+	 *
+	 * The fixed points are stored as little-endian 4 byte floats. They are 
+	 * rounded towards zero, and the arrays are encoded with the rounded fixed 
+	 * points. No section sizes are stored: every section but the last ends 
+	 * after its values for all peaks. A block is so smaller than the 
+	 * separately encoded arrays, by 1-3 bytes with Pic intensities and no ion
+	 * mobility and by 5-11 bytes otherwise, for less than 524288 peaks.
+	 *
+	 * The resulting binary is maximally 17 + dataSize * 15 bytes.
+	 *
+	 * @mz						pointer to the m/z array
+	 * @intensity				pointer to the intensity array
+	 * @ionMobility				pointer to the ion mobility array, or NULL if the 
+	 *							spectrum has none
+	 * @dataSize				number of peaks, i.e. doubles in each array
+	 * @result					pointer to where resulting bytes should be stored
+	 * @mzFixedPoint			fixed point for encodeLinear of the m/z array
+	 * @intensityCodec			codec for the intensity array
+	 * @intensityFixedPoint		fixed point for encodeSlof, ignored for INTENSITY_PIC
+	 * @ionMobilityFixedPoint	fixed point for encodeLinear of the ion mobility array
+	 * @return					the number of encoded bytes
+	 */
+	size_t encodeSpectrum(
+		const double *mz,
+		const double *intensity,
+		const double *ionMobility,
+		const size_t dataSize,
+		unsigned char *result,
+		double mzFixedPoint,
+		IntensityCodec intensityCodec,
+		double intensityFixedPoint,
+		double ionMobilityFixedPoint);
+
+	/**
+	 * Calls lower level encodeSpectrum while handling vector sizes appropriately.
+	 * An empty ionMobility vector encodes a spectrum without ion mobility.
+	 */
+	void encodeSpectrum(
+		const std::vector<double> &mz,
+		const std::vector<double> &intensity,
+		const std::vector<double> &ionMobility,
+		std::vector<unsigned char> &result,
+		double mzFixedPoint,
+		IntensityCodec intensityCodec,
+		double intensityFixedPoint,
+		double ionMobilityFixedPoint);
+
+	/**
+	 * Reads the number of peaks from the header of a spectrum block, which is
+	 * the number of doubles decodeSpectrum writes to each output array.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @return		the number of peaks in the spectrum
+	 */
+	size_t decodeSpectrumLength(
+		const unsigned char *data,
+		const size_t dataSize);
+
+	/**
+	 * Returns whether a spectrum block holds an ion mobility array.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 */
+	bool spectrumHasIonMobility(
+		const unsigned char *data,
+		const size_t dataSize);
+
+	/**
+	 * Decodes a spectrum block encoded by encodeSpectrum in one call. Every
+	 * section is decoded up to the shared peak count, so a corrupt block can
+	 * never write more than decodeSpectrumLength(data, dataSize) doubles to
+	 * any output.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @mz			pointer to were the decoded m/z values should be stored
+	 * @intensity	pointer to were the decoded intensities should be stored
+	 * @ionMobility	pointer to were the decoded ion mobilities should be stored,
+	 *				or NULL to skip decoding them
+	 * @return		the number of peaks
+	 */
+	size_t decodeSpectrum(
+		const unsigned char *data,
+		const size_t dataSize,
+		double *mz,
+		double *intensity,
+		double *ionMobility);
+
+	/**
+	 * Calls lower level decodeSpectrum while handling vector sizes appropriately.
+	 * ionMobility is left empty if the spectrum has no ion mobility array.
+	 */
+	void decodeSpectrum(
+		const std::vector<unsigned char> &data,
+		std::vector<double> &mz,
+		std::vector<double> &intensity,
+		std::vector<double> &ionMobility);
+
+/////////////////////////////////////////////////////////////
+
+	/**
+	 * Encodings that can be decoded block by block with a BlockDecoder.
+	 */
+	enum BlockCodec {
+		BLOCK_LINEAR 	= 0,
+		BLOCK_PIC 		= 1,
+		BLOCK_SLOF 		= 2
+	};
+
+	/**
+	 * Resumable state for decoding data encoded by encodeLinear, encodePic or
+	 * encodeSlof a block of values at a time, so that processing stages can 
+	 * consume the values without a full intermediate array.
+	 *
+	 * The encoded bytes need not all be available at once. As long as 
+	 * complete is false, decodeBlock only decodes values whose bytes are all 
+	 * in data. The owner may then point data to a larger buffer holding more
+	 * of the encoding, as long as the bytes from di on are kept in place
+	 * (bytes before di may be dropped by moving data and di along).
+	 */
+	struct BlockDecoder {
+		const unsigned char *data;	// encoded bytes available so far
+		size_t dataSize;			// number of bytes in data
+		bool complete;				// true when data ends with the encoding
+		bool finished;				// set by decodeBlock after the last value
+		
+		BlockCodec codec;
+		bool started;				// fixed point read
+		double fixedPoint;
+		size_t di;					// next byte to decode
+		size_t half;				// next halfbyte to decode in data[di]
+		size_t count;				// number of values decoded so far
+		long long ints[2];			// last two Numpress Lin fixed point values
+	};
+
+	/**
+	 * Prepares decoder for decoding dataSize bytes of data encoded with codec.
+	 *
+	 * @decoder		the state to initialize
+	 * @codec		the encoding of data
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes available in *data
+	 * @complete	whether data holds the whole encoding, or more will follow
+	 */
+	void initBlockDecoder(
+		BlockDecoder *decoder,
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		bool complete);
+
+	/**
+	 * Decodes up to maxValues values following the ones decoded so far by 
+	 * decoder. Returns fewer values only once the available bytes are used 
+	 * up, and 0 when decoder->finished is set or more bytes are needed.
+	 *
+	 * Values are identical to those of decodeLinear, decodePic or decodeSlof.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @decoder		the state of the decoding, as from initBlockDecoder
+	 * @result		pointer to where the decoded doubles should be stored
+	 * @maxValues	the maximum number of doubles to decode
+	 * @return		the number of decoded doubles
+	 */
+	size_t decodeBlock(
+		BlockDecoder *decoder,
+		double *result,
+		size_t maxValues);
+
+	/**
+	 * Number of values per block handed to visitors by visitBlocks, 2kB of 
+	 * doubles to stay in L1 cache.
+	 */
+	const size_t VISIT_BLOCK_SIZE = 256;
+
+	/**
+	 * Decodes data encoded with codec into a block buffer on the stack, and 
+	 * calls visitor(const double *values, size_t count) for every block of 
+	 * up to VISIT_BLOCK_SIZE values, in order. Processing is fused with 
+	 * decoding without a heap allocated output array, and the call to the 
+	 * visitor can be inlined. Decoding stops early when visitor returns false.
+	 *
+	 * visitor is passed by value as for standard algorithms, so pass a 
+	 * pointer or reference wrapper to keep results in a stateful visitor.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @codec		the encoding of data
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @visitor		function object called for each block of values
+	 * @return		the number of values handed to visitor
+	 */
+	template <class Visitor>
+	size_t visitBlocks(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		Visitor visitor
+	) {
+		double block[VISIT_BLOCK_SIZE];
+		BlockDecoder decoder;
+		size_t count;
+		size_t total = 0;
+		
+		initBlockDecoder(&decoder, codec, data, dataSize, true);
+		while ((count = decodeBlock(&decoder, block, VISIT_BLOCK_SIZE)) > 0) {
+			total += count;
+			if (!visitor(static_cast<const double *>(block), count)) break;
+		}
+		return total;
+	}
+
+	/**
+	 * Calls visitBlocks for data encoded by encodeLinear.
+	 */
+	template <class Visitor>
+	size_t decodeLinearBlocks(
+		const unsigned char *data,
+		size_t dataSize,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_LINEAR, data, dataSize, visitor);
+	}
+
+	template <class Visitor>
+	size_t decodeLinearBlocks(
+		const std::vector<unsigned char> &data,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_LINEAR, data.empty() ? NULL : &data[0], data.size(), visitor);
+	}
+
+	/**
+	 * Calls visitBlocks for data encoded by encodePic.
+	 */
+	template <class Visitor>
+	size_t decodePicBlocks(
+		const unsigned char *data,
+		size_t dataSize,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_PIC, data, dataSize, visitor);
+	}
+
+	template <class Visitor>
+	size_t decodePicBlocks(
+		const std::vector<unsigned char> &data,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_PIC, data.empty() ? NULL : &data[0], data.size(), visitor);
+	}
+
+	/**
+	 * Calls visitBlocks for data encoded by encodeSlof.
+	 */
+	template <class Visitor>
+	size_t decodeSlofBlocks(
+		const unsigned char *data,
+		size_t dataSize,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_SLOF, data, dataSize, visitor);
+	}
+
+	template <class Visitor>
+	size_t decodeSlofBlocks(
+		const std::vector<unsigned char> &data,
+		Visitor visitor
+	) {
+		return visitBlocks(BLOCK_SLOF, data.empty() ? NULL : &data[0], data.size(), visitor);
+	}
+
+/////////////////////////////////////////////////////////////
+
+	/**
+	 * PSI-MS accessions of the numpress compressions, as used in the 
+	 * binaryDataArray cvParams of mzML.
+	 */
+	const char * const ACC_NUMPRESS_LINEAR 		= "MS:1002312";
+	const char * const ACC_NUMPRESS_PIC 		= "MS:1002313";
+	const char * const ACC_NUMPRESS_SLOF 		= "MS:1002314";
+	const char * const ACC_NUMPRESS_LINEAR_ZLIB = "MS:1002746";
+	const char * const ACC_NUMPRESS_PIC_ZLIB 	= "MS:1002747";
+	const char * const ACC_NUMPRESS_SLOF_ZLIB 	= "MS:1002748";
+
+	/**
+	 * The compressions named by the accessions above, to be resolved once
+	 * per binaryDataArray type by resolveCvAccession rather than matching
+	 * strings for every array.
+	 */
+	enum CvCodec {
+		CV_UNKNOWN 				= 0,
+		CV_NUMPRESS_LINEAR 		= 1,
+		CV_NUMPRESS_PIC 		= 2,
+		CV_NUMPRESS_SLOF 		= 3,
+		CV_NUMPRESS_LINEAR_ZLIB = 4,
+		CV_NUMPRESS_PIC_ZLIB 	= 5,
+		CV_NUMPRESS_SLOF_ZLIB 	= 6
+	};
+
+	/**
+	 * Everything needed to encode or decode with one CvCodec. The "+ zlib" 
+	 * codecs share the functions of the plain ones, and need the data 
+	 * inflated before decoding (and deflated after encoding) by the caller.
+	 */
+	struct CodecDescriptor {
+		CvCodec cvCodec;
+		const char *accession;
+		const char *name;
+		BlockCodec codec;
+		bool zlib;
+		
+		// as encodeLinear, encodePic (which ignores fixedPoint) or encodeSlof
+		size_t (*encode)(const double *data, size_t dataSize, unsigned char *result, double fixedPoint);
+		// as decodeLinear, decodePic or decodeSlof
+		size_t (*decode)(const unsigned char *data, size_t dataSize, double *result);
+		// 0 for Pic
+		double (*optimalFixedPoint)(const double *data, size_t dataSize);
+		// most bytes encode writes for dataSize values
+		size_t (*encodeBound)(size_t dataSize);
+		// most values decode writes for dataSize bytes, exact for Slof
+		size_t (*decodeBound)(size_t dataSize);
+	};
+
+	/**
+	 * The CvCodec of a PSI-MS accession such as "MS:1002312", or CV_UNKNOWN.
+	 */
+	CvCodec resolveCvAccession(
+		const char *accession);
+
+	/**
+	 * The descriptor of cvCodec. Throws a const char* for CV_UNKNOWN.
+	 */
+	const CodecDescriptor &codecDescriptor(
+		CvCodec cvCodec);
+
+	/**
+	 * Decodes data with the functions of cvCodec, the C++ counterpart of 
+	 * the Java MSNumpress.decode(cvAccession, data, dataSize). Data of the 
+	 * "+ zlib" codecs must be inflated first.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @result		pointer to where resulting doubles should be stored, room for
+	 *				codecDescriptor(cvCodec).decodeBound(dataSize) doubles
+	 * @return		the number of decoded doubles
+	 */
+	size_t decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result);
+
+	/**
+	 * Calls lower level decode while handling vector sizes appropriately
+	 */
+	void decode(
+		CvCodec cvCodec,
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result);
+
+	/**
+	 * Decodes count arrays encoded with cvCodec, array i being dataSizes[i] 
+	 * bytes at data[i], one after the other into result, dispatching once 
+	 * for the whole batch. The values of array i are stored from 
+	 * result[offsets[i]] to result[offsets[i+1] - 1], so offsets must hold
+	 * count + 1 entries. result needs room for the sum of the decodeBounds.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @return		the total number of decoded doubles
+	 */
+	size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets);
+
+	/**
+	 * Same as decodeBatch, with array i encoded with cvCodecs[i].
+	 */
+	size_t decodeBatch(
+		const CvCodec *cvCodecs,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets);
+
+	/**
+	 * A reasonable streamingThreshold for decode and decodeBatch, 8MB of 
+	 * doubles, more than the last level cache share of a core on most 
+	 * machines. Nothing streams unless given a streamingThreshold.
+	 */
+	const size_t STREAMING_THRESHOLD = 8 << 20;
+
+	/**
+	 * Number of doubles in the buffer that streaming decodes go through, 
+	 * 256kB to stay in L2 cache.
+	 */
+	const size_t STREAM_BUFFER_SIZE = 32768;
+
+	/**
+	 * Same as decode, but if the decodeBound of data is at least
+	 * streamingThreshold bytes of doubles, values are decoded into a buffer
+	 * of STREAM_BUFFER_SIZE doubles, which stays in L2 cache, and copied to
+	 * result with non-temporal stores (SSE2 only). These bypass the cache 
+	 * and need no read for ownership of result, which pays off for outputs 
+	 * much larger than the cache that are not read back right away, e.g. 
+	 * written to disk or used on another NUMA node. Values are identical 
+	 * either way. A streamingThreshold of 0 never streams.
+	 *
+	 * @buffer		STREAM_BUFFER_SIZE doubles to decode through, to reuse 
+	 *				between calls, or NULL to allocate them when streaming
+	 */
+	size_t decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result,
+		size_t streamingThreshold,
+		double *buffer = NULL);
+
+	/**
+	 * Same as decodeBatch, streaming the values as decode with
+	 * streamingThreshold if the sum of the decodeBounds of the batch is at
+	 * least streamingThreshold bytes of doubles.
+	 */
+	size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t *offsets,
+		size_t streamingThreshold,
+		double *buffer = NULL);
+
+	/////////////////////////////////////////////////////////////////////////////////
+
+	/**
+	 * The fixed point for encodeLinear of values in [0, maxValue] where
+	 * consecutive values differ by at most maxStep (maxValue for any order),
+	 * from instrument bounds instead of a scan of the data. It is smaller 
+	 * than optimalLinearFixedPoint of the actual data, but guarantees that 
+	 * the data can be encoded.
+	 */
+	double linearFixedPointForBounds(
+		double maxValue,
+		double maxStep);
+
+	/**
+	 * The fixed point for encodeSlof of values in [0, maxValue], equal to
+	 * optimalSlofFixedPoint of data with maximum maxValue.
+	 */
+	double slofFixedPointForBounds(
+		double maxValue);
+
+	/**
+	 * Settings of encodeRealtime, fixed before acquisition starts.
+	 */
+	struct RealtimeEncoder {
+		BlockCodec codec;
+		double fixedPoint;		// ignored by Pic
+		double maxValue;		// larger values are saturated
+	};
+
+	/**
+	 * Prepares encoder for encoding values in [0, maxValue], differing by
+	 * at most maxStep between neighbours (only used by BLOCK_LINEAR), with
+	 * codec.
+	 */
+	void initRealtimeEncoder(
+		RealtimeEncoder *encoder,
+		BlockCodec codec,
+		double maxValue,
+		double maxStep);
+
+	/**
+	 * The number of bytes encodeRealtime needs for dataSize values.
+	 */
+	size_t realtimeEncodeBound(
+		BlockCodec codec,
+		size_t dataSize);
+
+	/**
+	 * Encodes a scan for acquisition software, where each scan must be 
+	 * encoded before the next one arrives. Never allocates or throws, and
+	 * does a bounded amount of work per value:
+	 *
+	 *  - values outside [0, encoder->maxValue] (and NaN) are saturated, and
+	 *    so are Linear residuals outside the int range, keeping the result 
+	 *    decodable by decodeLinear, decodePic or decodeSlof,
+	 *  - Linear and Pic write the halfbytes of each int without data 
+	 *    dependent branches, with results identical to encodeLinear and
+	 *    encodePic for values within bounds,
+	 *  - Slof takes a branch-free approximate log per value, as encodeSlofFast.
+	 *
+	 * The bound on the work per value follows from the code: every value 
+	 * runs the same fixed sequence of instructions, without allocation and 
+	 * without loops whose trip count depends on the data. The only branches
+	 * written on the data are the saturation checks, one on the value and 
+	 * one on the Linear residual or the Slof logarithm, taken only when a 
+	 * value is saturated; the other conditionals are selects. Counting leading zero halfbytes is one instruction with 
+	 * GCC, and a loop of at most 8 steps otherwise. A scan thus takes time
+	 * linear in its size whatever the data, and the budget per value is a
+	 * fixed instruction count times the cycles the target machine needs 
+	 * per instruction.
+	 *
+	 * As an example only, MSNumpressBench --latency measured on a shared 
+	 * single core x86-64 VM (g++ -O2) a p99.9 per value of up to 45 ns for 
+	 * Linear, 52 ns for Pic and 113 ns for Slof, against a p50 of 7 to 13 ns.
+	 * That tail comes from the OS preempting the thread, which only real 
+	 * time scheduling of the acquisition thread avoids.
+	 *
+	 * @encoder			the settings, as from initRealtimeEncoder
+	 * @data			pointer to array of doubles to be encoded
+	 * @dataSize		number of doubles from *data to encode
+	 * @result			pointer to the preallocated output
+	 * @resultCapacity	bytes at result, at least realtimeEncodeBound(codec, dataSize)
+	 * @clamped			if not NULL, set to the number of saturated values
+	 * @return			the number of encoded bytes, or 0 if resultCapacity 
+	 *					is too small (nothing is written then)
+	 */
+	size_t encodeRealtime(
+		const RealtimeEncoder *encoder,
+		const double *data,
+		size_t dataSize,
+		unsigned char *result,
+		size_t resultCapacity,
+		size_t *clamped);
+
 } // namespace MSNumpress
 } // namespace msdata
 } // namespace pwiz
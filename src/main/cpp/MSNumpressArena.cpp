@@ -0,0 +1,282 @@
+/*
+	MSNumpressArena.cpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "MSNumpressArena.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ms {
+namespace numpress {
+namespace MSNumpress {
+
+using std::min;
+using std::max;
+
+#ifdef __linux__
+
+/**
+ * Maps size bytes (a multiple of HUGE_PAGE_SIZE) of hugetlbfs pages, or
+ * returns NULL if there are not enough reserved.
+ */
+static void *mapExplicit(
+		size_t size
+) {
+#ifdef MAP_HUGETLB
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+#else
+	(void)size;
+	return NULL;
+#endif
+}
+
+
+
+/**
+ * Maps size bytes (a multiple of HUGE_PAGE_SIZE) of regular pages, aligned
+ * to HUGE_PAGE_SIZE so that the kernel can back them with huge pages, or
+ * returns NULL. Swap is not reserved, as the pages are only touched once
+ * written.
+ */
+static void *mapAligned(
+		size_t size
+) {
+	size_t mapped = size + HUGE_PAGE_SIZE;
+	void *p = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) return NULL;
+
+	// unmap the parts before and after the aligned size bytes
+	unsigned char *start = static_cast<unsigned char *>(p);
+	size_t head = (HUGE_PAGE_SIZE - reinterpret_cast<size_t>(start) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+	if (head > 0) munmap(start, head);
+	if (mapped - head - size > 0) munmap(start + head + size, mapped - head - size);
+	return start + head;
+}
+
+#endif
+
+
+
+HugePageArena::HugePageArena(
+		size_t capacity,
+		HugePages hugePages
+) :
+		base(NULL),
+		size((max(capacity, static_cast<size_t>(1)) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE),
+		offset(0),
+		last(0),
+		pages(HUGE_PAGES_NONE),
+		mapping(NULL),
+		mappingSize(0)
+{
+#ifdef __linux__
+	if (hugePages == HUGE_PAGES_EXPLICIT && (mapping = mapExplicit(size)) != NULL) {
+		pages = HUGE_PAGES_EXPLICIT;
+	} else if ((mapping = mapAligned(size)) != NULL) {
+#ifdef MADV_HUGEPAGE
+		if (hugePages != HUGE_PAGES_NONE && madvise(mapping, size, MADV_HUGEPAGE) == 0)
+			pages = HUGE_PAGES_TRANSPARENT;
+#endif
+	} else {
+		throw "[MSNumpress::HugePageArena] Could not map arena memory! ";
+	}
+	mappingSize = size;
+	base = static_cast<unsigned char *>(mapping);
+#else
+	(void)hugePages;
+	mapping = std::malloc(size + ARENA_ALIGNMENT);
+	if (mapping == NULL)
+		throw "[MSNumpress::HugePageArena] Could not allocate arena memory! ";
+	mappingSize = size + ARENA_ALIGNMENT;
+	base = static_cast<unsigned char *>(mapping) +
+			(ARENA_ALIGNMENT - reinterpret_cast<size_t>(mapping) % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+#endif
+}
+
+
+
+HugePageArena::~HugePageArena() {
+#ifdef __linux__
+	munmap(mapping, mappingSize);
+#else
+	std::free(mapping);
+#endif
+}
+
+
+
+void *HugePageArena::allocate(
+		size_t bytes,
+		size_t alignment
+) {
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+		throw "[MSNumpress::HugePageArena] Alignment is not a power of 2! ";
+
+	size_t address = reinterpret_cast<size_t>(base) + offset;
+	size_t start = offset + (alignment - address % alignment) % alignment;
+	if (start > size || bytes > size - start)
+		throw "[MSNumpress::HugePageArena] Out of arena memory! ";
+
+	last = start;
+	offset = start + bytes;
+	return base + start;
+}
+
+
+
+void HugePageArena::shrink(
+		void *p,
+		size_t bytes
+) {
+	if (p != base + last || bytes > offset - last)
+		throw "[MSNumpress::HugePageArena] Can only shrink the last allocation! ";
+	offset = last + bytes;
+}
+
+
+
+void HugePageArena::reset() {
+	offset = 0;
+	last = 0;
+}
+
+
+
+size_t HugePageArena::capacity() const {
+	return size;
+}
+
+
+
+size_t HugePageArena::used() const {
+	return offset;
+}
+
+
+
+HugePages HugePageArena::hugePages() const {
+	return pages;
+}
+
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		HugePageArena &arena,
+		size_t *offsets,
+		double **result
+) {
+	const CodecDescriptor &descriptor = codecDescriptor(cvCodec);
+	size_t i, bound, decoded;
+
+	for (i=0, bound=0; i<count; i++) {
+		bound += descriptor.decodeBound(dataSizes[i]);
+	}
+
+	double *values = static_cast<double *>(arena.allocate(bound * sizeof(double)));
+	try {
+		decoded = decodeBatch(cvCodec, data, dataSizes, count, values, offsets);
+	} catch (...) {
+		arena.shrink(values, 0);
+		throw;
+	}
+	arena.shrink(values, decoded * sizeof(double));
+	*result = values;
+	return decoded;
+}
+
+
+
+
+#ifdef MSNUMPRESS_PMR
+
+/////////////////////////////////////////////////////////////
+
+
+HugePageResource::HugePageResource(
+		HugePageArena &arena
+) :
+		arena(arena)
+{}
+
+
+
+void *HugePageResource::do_allocate(
+		size_t bytes,
+		size_t alignment
+) {
+	try {
+		return arena.allocate(bytes, max(alignment, ARENA_ALIGNMENT));
+	} catch (const char *) {
+		throw std::bad_alloc();
+	}
+}
+
+
+
+void HugePageResource::do_deallocate(
+		void *,
+		size_t,
+		size_t
+) {
+}
+
+
+
+bool HugePageResource::do_is_equal(
+		const std::pmr::memory_resource &other
+) const noexcept {
+	return this == &other;
+}
+
+
+
+void decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		std::pmr::vector<double> &result
+) {
+	// decode into scratch memory first, as the decodeBound can be several 
+	// times the decoded values, and the arena never gets memory back
+	const CodecDescriptor &descriptor = codecDescriptor(cvCodec);
+	std::vector<double> decoded(descriptor.decodeBound(dataSize));
+	size_t decodedLength = descriptor.decode(data, dataSize, decoded.data());
+	result.assign(decoded.begin(), decoded.begin() + decodedLength);
+}
+
+#endif
+
+} // namespace MSNumpress
+} // namespace msdata
+} // namespace pwiz
@@ -0,0 +1,210 @@
+/*
+	MSNumpressArena.hpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+/*
+	==================== huge page arenas ====================
+	Decoding whole runs into memory backed by 2MB pages, so that tens of GB
+	of decoded values take few TLB entries. Unlike MSNumpress.hpp, this
+	part needs C++11, and C++17 for the std::pmr::memory_resource.
+
+	A HugePageArena maps its capacity once, on LINUX as transparent huge
+	pages (madvise MADV_HUGEPAGE) or explicit hugetlbfs pages (MAP_HUGETLB),
+	and hands out 64 byte aligned parts of it one after the other. Memory is
+	only given back all at once, by reset or the destructor. decodeBatch
+	places the values of a batch in an arena, and HugePageResource lets
+	std::pmr containers, as taken by the pmr decode, allocate from one.
+ */
+
+#ifndef _MSNUMPRESS_ARENA_HPP_
+#define _MSNUMPRESS_ARENA_HPP_
+
+#include <cstddef>
+#include "MSNumpress.hpp"
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#include <vector>
+#define MSNUMPRESS_PMR
+#endif
+#endif
+
+namespace ms {
+namespace numpress {
+
+namespace MSNumpress {
+
+	/**
+	 * The pages backing a HugePageArena.
+	 */
+	enum HugePages {
+		HUGE_PAGES_NONE 		= 0,	// regular pages
+		HUGE_PAGES_TRANSPARENT 	= 1,	// madvise(MADV_HUGEPAGE), used if THP is
+										// enabled as "always" or "madvise"
+		HUGE_PAGES_EXPLICIT 	= 2		// MAP_HUGETLB, needs pages reserved in
+										// /proc/sys/vm/nr_hugepages
+	};
+
+	/**
+	 * Alignment of every allocation of a HugePageArena, a cache line and
+	 * the width of AVX-512 vectors.
+	 */
+	const size_t ARENA_ALIGNMENT = 64;
+
+	/**
+	 * Size of the huge pages arenas are mapped in, and rounded up to.
+	 */
+	const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	/**
+	 * Memory for decoded values, mapped once with huge pages if available,
+	 * and handed out in order. Consecutive allocations are contiguous up to
+	 * their alignment. Pages are only touched, and so only take physical
+	 * memory, once written.
+	 *
+	 * An arena must not be used by several threads at once, so use one
+	 * arena per thread.
+	 */
+	class HugePageArena {
+	public:
+		/**
+		 * Maps capacity bytes, rounded up to HUGE_PAGE_SIZE. If explicit huge
+		 * pages cannot be mapped, transparent ones are tried, and on systems
+		 * without huge pages the arena has regular pages. Throws a const
+		 * char* if the memory cannot be mapped at all.
+		 *
+		 * @capacity	the most bytes the arena can hand out
+		 * @hugePages	the pages to try first
+		 */
+		explicit HugePageArena(
+			size_t capacity,
+			HugePages hugePages = HUGE_PAGES_TRANSPARENT);
+
+		~HugePageArena();
+
+		/**
+		 * Returns bytes of memory aligned to alignment (a power of 2),
+		 * following the last allocation. Throws a const char* if the arena
+		 * is full.
+		 */
+		void *allocate(
+			size_t bytes,
+			size_t alignment = ARENA_ALIGNMENT);
+
+		/**
+		 * Shrinks the last allocation, at last, to bytes, so that the next
+		 * allocation follows these bytes.
+		 */
+		void shrink(
+			void *last,
+			size_t bytes);
+
+		/**
+		 * Makes the whole capacity available again, invalidating all memory
+		 * handed out so far. The pages stay mapped.
+		 */
+		void reset();
+
+		size_t capacity() const;
+
+		/**
+		 * Bytes handed out so far, including alignment padding.
+		 */
+		size_t used() const;
+
+		/**
+		 * The pages the arena was mapped with. HUGE_PAGES_TRANSPARENT means
+		 * the kernel accepted the advice, see AnonHugePages in
+		 * /proc/meminfo for what it did.
+		 */
+		HugePages hugePages() const;
+
+	private:
+		unsigned char *base;
+		size_t size;
+		size_t offset;
+		size_t last;			// offset of the last allocation
+		HugePages pages;
+		void *mapping;			// what to unmap or free
+		size_t mappingSize;
+
+		HugePageArena(const HugePageArena &);
+		HugePageArena &operator=(const HugePageArena &);
+	};
+
+	/**
+	 * Same as decodeBatch, placing the values in arena right after its last
+	 * allocation, at ARENA_ALIGNMENT. Room for the sum of the decodeBounds
+	 * is taken from arena, and shrunk to the decoded values afterwards, so
+	 * the values of consecutive batches follow each other.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data
+	 * to be corrupt, or if arena is full.
+	 *
+	 * @result		set to the start of the values in arena
+	 * @return		the total number of decoded doubles
+	 */
+	size_t decodeBatch(
+		CvCodec cvCodec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		HugePageArena &arena,
+		size_t *offsets,
+		double **result);
+
+#ifdef MSNUMPRESS_PMR
+	/**
+	 * A std::pmr::memory_resource allocating from a HugePageArena, aligned
+	 * to at least ARENA_ALIGNMENT. Deallocation does nothing, memory is
+	 * given back by resetting the arena. Throws std::bad_alloc if the arena
+	 * is full, as containers expect.
+	 */
+	class HugePageResource : public std::pmr::memory_resource {
+	public:
+		/**
+		 * @arena	the arena to allocate from, which must outlive the resource
+		 */
+		explicit HugePageResource(HugePageArena &arena);
+
+	private:
+		void *do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+		HugePageArena &arena;
+	};
+
+	/**
+	 * Same as decode, into a std::pmr::vector, which for values in huge
+	 * pages has a HugePageResource. result keeps its memory resource. The 
+	 * values are decoded into heap memory first and then copied, so that 
+	 * an empty result takes exactly the decoded values from its resource.
+	 */
+	void decode(
+		CvCodec cvCodec,
+		const unsigned char *data,
+		size_t dataSize,
+		std::pmr::vector<double> &result);
+#endif
+
+} // namespace MSNumpress
+} // namespace msdata
+} // namespace pwiz
+
+#endif // _MSNUMPRESS_ARENA_HPP_
@@ -0,0 +1,508 @@
+/*
+	MSNumpressBench.cpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+	Compile and run benchmarks (on LINUX) with
+
+	> g++ -O2 MSNumpress.cpp MSNumpressArena.cpp MSNumpressBench.cpp -o bench && \
+		./bench [--counters] [--latency] [--batch]
+
+	Encoding and decoding with every codec is timed on typical data
+	distributions, repeating each for at least MIN_SECONDS. With --counters, the hardware counters of the decode
+	loops are read with perf_event_open, and reported as IPC and counts per
+	decoded value. Counters that cannot be opened (no PMU, as in many virtual
+	machines, or kernel.perf_event_paranoid too high) are shown as "-".
+	With --latency, the p50/p99/p99.9 latencies of encodeRealtime per scan
+	are reported for several scan sizes, including worst case data.
+	With --batch, decoding many scattered arrays into an output much larger
+	than the cache is timed array by array, with decodeBatch (which
+	prefetches arrays), with decodeBatch with non-temporal (streaming)
+	stores, and with decodeBatch into an arena of regular and of huge pages
+	(if the kernel accepts madvise MADV_HUGEPAGE).
+ */
+
+#include "MSNumpress.hpp"
+#include "MSNumpressArena.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace ms::numpress::MSNumpress;
+
+const double MIN_SECONDS 	= 0.2;
+const size_t N 				= 100000;
+
+double sink;
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+enum Counter {
+	CYCLES = 0,
+	INSTRUCTIONS,
+	BRANCH_MISSES,
+	L1D_MISSES,
+	LLC_MISSES,
+	COUNTERS
+};
+
+const char *COUNTER_NAMES[COUNTERS] = { "cycles", "instr", "br-miss", "L1d-miss", "LLC-miss" };
+
+/**
+ * Hardware counters of the calling thread, in user space. Each counter is
+ * opened on its own, so that the available ones are kept if others fail, and
+ * scaled by its enabled / running time when the kernel multiplexes them.
+ */
+struct PerfCounters {
+	int fd[COUNTERS];
+	double values[COUNTERS];		// last measurement, or -1 if unavailable
+};
+
+
+
+void openCounters(PerfCounters *pc, bool enable) {
+	for (int c=0; c<COUNTERS; c++) {
+		pc->fd[c] = -1;
+		pc->values[c] = -1;
+	}
+#ifdef __linux__
+	if (!enable) return;
+
+	static const unsigned int types[COUNTERS] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+	};
+	static const unsigned long long configs[COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+
+	for (int c=0; c<COUNTERS; c++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size 			= sizeof(attr);
+		attr.type 			= types[c];
+		attr.config 		= configs[c];
+		attr.disabled 		= 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv 	= 1;
+		attr.read_format 	= PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		pc->fd[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#else
+	(void)enable;
+#endif
+}
+
+
+
+void closeCounters(PerfCounters *pc) {
+#ifdef __linux__
+	for (int c=0; c<COUNTERS; c++)
+		if (pc->fd[c] >= 0) close(pc->fd[c]);
+#endif
+}
+
+
+
+void startCounters(PerfCounters *pc) {
+#ifdef __linux__
+	for (int c=0; c<COUNTERS; c++) {
+		if (pc->fd[c] < 0) continue;
+		ioctl(pc->fd[c], PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc->fd[c], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#else
+	(void)pc;
+#endif
+}
+
+
+
+void stopCounters(PerfCounters *pc) {
+#ifdef __linux__
+	for (int c=0; c<COUNTERS; c++) {
+		pc->values[c] = -1;
+		if (pc->fd[c] < 0) continue;
+		ioctl(pc->fd[c], PERF_EVENT_IOC_DISABLE, 0);
+
+		unsigned long long v[3];	// value, time enabled, time running
+		if (read(pc->fd[c], v, sizeof(v)) != sizeof(v) || v[2] == 0) continue;
+		pc->values[c] = static_cast<double>(v[0]) * v[1] / v[2];
+	}
+#else
+	(void)pc;
+#endif
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+std::vector<double> mzData(size_t n) {
+	std::vector<double> mzs(n);
+	mzs[0] = 300 + rand() / (double)RAND_MAX;
+	for (size_t i=1; i<n; i++)
+		mzs[i] = mzs[i-1] + rand() / (double)RAND_MAX;
+	return mzs;
+}
+
+std::vector<double> intensityData(size_t n) {
+	std::vector<double> ics(n);
+	for (size_t i=0; i<n; i++)
+		ics[i] = pow(10, 6.0 * rand() / RAND_MAX);
+	return ics;
+}
+
+/**
+ * Profile-like intensities, mostly zero between peaks.
+ */
+std::vector<double> sparseData(size_t n) {
+	std::vector<double> ics(n, 0.0);
+	for (size_t i=0; i<n; i++)
+		if (rand() % 8 == 0) ics[i] = pow(10, 4.0 * rand() / RAND_MAX);
+	return ics;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+double seconds(
+		std::chrono::steady_clock::time_point start
+) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+/**
+ * Encodes data with codec, for Slof with encodeSlofFast if fast.
+ */
+size_t encode(
+		BlockCodec codec,
+		const std::vector<double> &data,
+		unsigned char *result,
+		bool fast = false
+) {
+	if (codec == BLOCK_LINEAR) 	return encodeLinear(&data[0], data.size(), result, optimalLinearFixedPoint(&data[0], data.size()));
+	if (codec == BLOCK_PIC) 	return encodePic(&data[0], data.size(), result);
+	if (fast) 					return encodeSlofFast(&data[0], data.size(), result, optimalSlofFixedPoint(&data[0], data.size()));
+	return encodeSlof(&data[0], data.size(), result, optimalSlofFixedPoint(&data[0], data.size()));
+}
+
+
+
+size_t decode(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result
+) {
+	if (codec == BLOCK_LINEAR) 	return decodeLinear(data, dataSize, result);
+	if (codec == BLOCK_PIC) 	return decodePic(data, dataSize, result);
+	return decodeSlof(data, dataSize, result);
+}
+
+
+
+void printCount(double count) {
+	if (count < 0) 	printf(" %9s", "-");
+	else 			printf(" %9.3f", count);
+}
+
+
+
+/**
+ * Times encoding and decoding data with codec, reading the counters of the
+ * decode repetitions. fast encodes Slof with encodeSlofFast.
+ */
+void bench(
+		const char *name,
+		BlockCodec codec,
+		const std::vector<double> &data,
+		PerfCounters *pc,
+		bool fast = false
+) {
+	std::vector<unsigned char> encoded(data.size() * 5 + 8);
+	std::vector<double> decoded(data.size() * 2 + 2);
+	size_t encodedBytes = 0, decodedValues = 0;
+	size_t runs;
+	std::chrono::steady_clock::time_point start;
+
+	start = std::chrono::steady_clock::now();
+	for (runs=0; runs == 0 || seconds(start) < MIN_SECONDS; runs++)
+		encodedBytes = encode(codec, data, &encoded[0], fast);
+	double encodeNs = seconds(start) * 1e9 / runs / data.size();
+
+	// warm up caches and branch predictors before counting
+	decode(codec, &encoded[0], encodedBytes, &decoded[0]);
+
+	startCounters(pc);
+	start = std::chrono::steady_clock::now();
+	for (runs=0; runs == 0 || seconds(start) < MIN_SECONDS; runs++) {
+		decodedValues = decode(codec, &encoded[0], encodedBytes, &decoded[0]);
+		sink += decoded[decodedValues - 1];
+	}
+	double decodeSeconds = seconds(start);
+	stopCounters(pc);
+
+	double values = static_cast<double>(runs) * decodedValues;
+	printf("%-22s %6.2f %9.2f %9.2f %9.1f", name,
+			encodedBytes / (double)data.size(),
+			encodeNs, decodeSeconds * 1e9 / values,
+			encodedBytes * (double)runs / decodeSeconds / 1e6);
+
+	if (pc->fd[CYCLES] >= 0 || pc->fd[INSTRUCTIONS] >= 0) {
+		double cycles = pc->values[CYCLES], instructions = pc->values[INSTRUCTIONS];
+		printCount(cycles > 0 && instructions >= 0 ? instructions / cycles : -1);
+		for (int c=0; c<COUNTERS; c++)
+			printCount(pc->values[c] < 0 ? -1 : pc->values[c] / values);
+	}
+	printf("\n");
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+const size_t SCAN_SIZES[] 	= { 100, 1000, 10000, 100000 };
+const size_t MIN_SAMPLES 	= 1000;
+const size_t MAX_SAMPLES 	= 100000;
+
+/**
+ * Scans whose every value needs 9 halfbytes with the realtime Linear and Pic 
+ * encoders, as residuals of 2 * maxValue or values of at least 2^28.
+ */
+std::vector<double> worstData(size_t n, double maxValue) {
+	std::vector<double> data(n);
+	for (size_t i=0; i<n; i++)
+		data[i] = i % 2 == 0 ? maxValue : 0;
+	return data;
+}
+
+
+
+/**
+ * Reports the percentiles of the latency of encodeRealtime per scan, for 
+ * scans of SCAN_SIZES values from data, starting at varying offsets.
+ */
+void latency(
+		const char *name,
+		const RealtimeEncoder &encoder,
+		const std::vector<double> &data
+) {
+	std::vector<unsigned char> encoded(realtimeEncodeBound(encoder.codec, data.size()));
+	std::vector<double> ns;
+	size_t clamped;
+
+	for (size_t si=0; si<sizeof(SCAN_SIZES) / sizeof(SCAN_SIZES[0]); si++) {
+		size_t n = SCAN_SIZES[si];
+		if (n > data.size()) continue;
+
+		ns.clear();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (ns.size() < MAX_SAMPLES && (ns.size() < MIN_SAMPLES || seconds(start) < MIN_SECONDS)) {
+			size_t offset = (ns.size() * 7919) % (data.size() - n + 1);
+			std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+			sink += encodeRealtime(&encoder, &data[offset], n, &encoded[0], encoded.size(), &clamped);
+			ns.push_back(seconds(t) * 1e9);
+		}
+		std::sort(ns.begin(), ns.end());
+
+		double p50 	= ns[ns.size() / 2];
+		double p99 	= ns[ns.size() * 99 / 100];
+		double p999 = ns[ns.size() * 999 / 1000];
+		printf("%-22s %7lu %10.0f %10.0f %10.0f %10.0f %9.2f\n", name, (unsigned long)n,
+				p50, p99, p999, ns.back(), p999 / n);
+	}
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+const size_t BATCH_TOTAL 	= 16384000;
+
+/**
+ * Encodes BATCH_TOTAL / n arrays of n values from data with codec, each in 
+ * its own allocation, as spectra read from a file.
+ */
+std::vector<std::vector<unsigned char> > batchData(
+		BlockCodec codec,
+		const std::vector<double> &data,
+		size_t n
+) {
+	std::vector<std::vector<unsigned char> > arrays(BATCH_TOTAL / n);
+	std::vector<double> values(n);
+	std::vector<unsigned char> encoded(n * 5 + 8);
+	for (size_t a=0; a<arrays.size(); a++) {
+		size_t offset = (a * 7919) % (data.size() - n + 1);
+		values.assign(data.begin() + offset, data.begin() + offset + n);
+		arrays[a].assign(encoded.begin(), encoded.begin() + encode(codec, values, &encoded[0]));
+	}
+	return arrays;
+}
+
+
+
+/**
+ * Times decoding the arrays in shuffled order, as scattered in memory, into
+ * one output much larger than the cache: array by array, with decodeBatch,
+ * with decodeBatch with non-temporal stores, and with decodeBatch into a
+ * HugePageArena of regular and of transparent huge pages.
+ */
+void batch(
+		const char *name,
+		CvCodec cvCodec,
+		const std::vector<std::vector<unsigned char> > &arrays
+) {
+	const CodecDescriptor &d = codecDescriptor(cvCodec);
+	std::vector<const unsigned char *> data(arrays.size());
+	std::vector<size_t> dataSizes(arrays.size()), offsets(arrays.size() + 1);
+	size_t bound = 0, decodedValues = 0;
+	for (size_t a=0; a<arrays.size(); a++) {
+		size_t s = (a * 7919) % arrays.size();
+		data[a] = &arrays[s][0];
+		dataSizes[a] = arrays[s].size();
+		bound += d.decodeBound(dataSizes[a]);
+	}
+	std::vector<double> result(bound);
+	HugePageArena arena4k(bound * sizeof(double), HUGE_PAGES_NONE);
+	HugePageArena arena2M(bound * sizeof(double), HUGE_PAGES_TRANSPARENT);
+	double *values = NULL;
+
+	const char *modes[5] = { "arrays", "batch", "streaming", "arena 4kB", "arena 2MB" };
+	for (int mode=0; mode<5; mode++) {
+		HugePageArena &arena = mode == 3 ? arena4k : arena2M;
+		if (mode == 4 && arena2M.hugePages() == HUGE_PAGES_NONE) 
+			continue;
+		size_t runs;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (runs=0; runs == 0 || seconds(start) < MIN_SECONDS; runs++) {
+			if (mode == 0) {
+				offsets[0] = 0;
+				for (size_t a=0; a<data.size(); a++) 
+					offsets[a+1] = offsets[a] + d.decode(data[a], dataSizes[a], &result[offsets[a]]);
+				decodedValues = offsets[data.size()];
+			} else if (mode < 3) {
+				decodedValues = decodeBatch(cvCodec, &data[0], &dataSizes[0], data.size(), 
+						&result[0], &offsets[0], mode == 2 ? 1 : 0);
+			} else {
+				arena.reset();
+				decodedValues = decodeBatch(cvCodec, &data[0], &dataSizes[0], data.size(), 
+						arena, &offsets[0], &values);
+			}
+			sink += mode < 3 ? result[decodedValues - 1] : values[decodedValues - 1];
+		}
+		double values = static_cast<double>(runs) * decodedValues;
+		double decodeSeconds = seconds(start);
+		printf("%-22s %-10s %9.1f %9.2f %9.2f\n", name, modes[mode],
+				decodedValues * sizeof(double) / 1e6,
+				decodeSeconds * 1e9 / values, 
+				values * sizeof(double) / decodeSeconds / 1e9);
+	}
+}
+
+
+
+
+int main(int argc, const char* argv[]) {
+	bool counters = false, latencies = false, batches = false;
+	for (int i=1; i<argc; i++) {
+		if (std::string(argv[i]) == "--counters") counters = true;
+		if (std::string(argv[i]) == "--latency") latencies = true;
+		if (std::string(argv[i]) == "--batch") batches = true;
+	}
+
+	PerfCounters pc;
+	openCounters(&pc, counters);
+
+	bool available = false;
+	for (int c=0; c<COUNTERS; c++)
+		available |= pc.fd[c] >= 0;
+	if (counters && !available)
+		printf("hardware counters unavailable (see kernel.perf_event_paranoid), timing only\n\n");
+
+	srand(123459);
+	std::vector<double> mzs 		= mzData(N);
+	std::vector<double> intensities = intensityData(N);
+	std::vector<double> sparse 		= sparseData(N);
+
+	printf("%-22s %6s %9s %9s %9s", "codec / data", "B/val", "enc ns/v", "dec ns/v", "dec MB/s");
+	if (available) {
+		printf(" %9s", "IPC");
+		for (int c=0; c<COUNTERS; c++)
+			printf(" %9s", (std::string(COUNTER_NAMES[c]) + "/v").c_str());
+	}
+	printf("\n");
+
+	bench("linear / mz", 		BLOCK_LINEAR, 	mzs, 			&pc);
+	bench("pic / intensity", 	BLOCK_PIC, 		intensities, 	&pc);
+	bench("pic / sparse", 		BLOCK_PIC, 		sparse, 		&pc);
+	bench("slof / intensity", 	BLOCK_SLOF, 	intensities, 	&pc);
+	bench("slof / sparse", 		BLOCK_SLOF, 	sparse, 		&pc);
+	bench("slof fast / intensity", BLOCK_SLOF, 	intensities, 	&pc, true);
+	bench("slof fast / sparse", BLOCK_SLOF, 	sparse, 		&pc, true);
+
+	if (latencies) {
+		RealtimeEncoder linear, pic, slof, worstLinear;
+		initRealtimeEncoder(&linear, BLOCK_LINEAR, 2 * mzs.back(), 10);
+		initRealtimeEncoder(&worstLinear, BLOCK_LINEAR, 2000, 2000);
+		initRealtimeEncoder(&pic, BLOCK_PIC, 1e9, 0);
+		initRealtimeEncoder(&slof, BLOCK_SLOF, 1e9, 0);
+
+		printf("\n%-22s %7s %10s %10s %10s %10s %9s\n", "realtime encode", "values", 
+				"p50 ns", "p99 ns", "p99.9 ns", "max ns", "p99.9 /v");
+		latency("linear / mz", 			linear, 		mzs);
+		latency("linear / worst", 		worstLinear, 	worstData(N, 2000));
+		latency("pic / intensity", 		pic, 			intensities);
+		latency("pic / worst", 			pic, 			worstData(N, 1e9));
+		latency("slof / intensity", 	slof, 			intensities);
+	}
+
+	if (batches) {
+		printf("\n%-22s %-10s %9s %9s %9s\n", "batch decode", "decode", "MB out", "ns/v", "out GB/s");
+		batch("linear / mz x1000", 	CV_NUMPRESS_LINEAR, batchData(BLOCK_LINEAR, mzs, 1000));
+		batch("linear / mz x20", 	CV_NUMPRESS_LINEAR, batchData(BLOCK_LINEAR, mzs, 20));
+		batch("pic / intensity x1000", CV_NUMPRESS_PIC, batchData(BLOCK_PIC, intensities, 1000));
+		batch("pic / intensity x20", CV_NUMPRESS_PIC, 	batchData(BLOCK_PIC, intensities, 20));
+		batch("slof / intensity x1000", CV_NUMPRESS_SLOF, batchData(BLOCK_SLOF, intensities, 1000));
+		batch("slof / intensity x20", CV_NUMPRESS_SLOF, batchData(BLOCK_SLOF, intensities, 20));
+	}
+
+	closeCounters(&pc);
+	return sink == 0.12345 ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+/*
+	MSNumpressC.cpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <new>
+#include <string>
+#include <vector>
+#include "MSNumpress.hpp"
+#include "MSNumpressC.h"
+
+using namespace ms::numpress::MSNumpress;
+
+struct msnumpress_context {
+	std::string error;
+	size_t streamingThreshold;		// value-initialized to 0 by new
+	std::vector<double> streamBuffer;
+};
+
+
+
+/**
+ * Records message as the last error of context and returns status.
+ */
+static msnumpress_status fail(
+		msnumpress_context *context,
+		msnumpress_status status,
+		const char *message
+) {
+	if (context != NULL) context->error = message;
+	return status;
+}
+
+
+
+static bool validCodec(
+		msnumpress_codec codec
+) {
+	return codec == MSNUMPRESS_LINEAR || codec == MSNUMPRESS_PIC || codec == MSNUMPRESS_SLOF;
+}
+
+
+
+/**
+ * The CV accession of the plain numpress codec.
+ */
+static CvCodec cvCodec(
+		msnumpress_codec codec
+) {
+	switch (codec) {
+		case MSNUMPRESS_LINEAR: 	return CV_NUMPRESS_LINEAR;
+		case MSNUMPRESS_PIC: 		return CV_NUMPRESS_PIC;
+		case MSNUMPRESS_SLOF: 		return CV_NUMPRESS_SLOF;
+	}
+	return CV_UNKNOWN;
+}
+
+
+
+/**
+ * The C codec of a BlockCodec.
+ */
+static msnumpress_codec cCodec(
+		BlockCodec codec
+) {
+	switch (codec) {
+		case BLOCK_LINEAR: 	return MSNUMPRESS_LINEAR;
+		case BLOCK_PIC: 	return MSNUMPRESS_PIC;
+		case BLOCK_SLOF: 	return MSNUMPRESS_SLOF;
+	}
+	return MSNUMPRESS_LINEAR;
+}
+
+
+
+/**
+ * The registry entry of the plain numpress codec.
+ */
+static const CodecDescriptor &descriptor(
+		msnumpress_codec codec
+) {
+	return codecDescriptor(cvCodec(codec));
+}
+
+
+
+/**
+ * The buffer the streaming decodes of context go through, allocated on first
+ * use and kept for later calls, or NULL if context does not stream.
+ */
+static double *streamBuffer(
+		msnumpress_context *context
+) {
+	if (context->streamingThreshold == 0) return NULL;
+	if (context->streamBuffer.empty()) context->streamBuffer.resize(STREAM_BUFFER_SIZE);
+	return &context->streamBuffer[0];
+}
+
+
+
+/**
+ * Decodes into at most resultCapacity doubles, throwing like the C++ decoders
+ * on corrupt data. Returns MSNUMPRESS_ERROR_BUFFER if there are more values.
+ */
+static msnumpress_status decodeBounded(
+		msnumpress_context *context,
+		msnumpress_codec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result,
+		size_t resultCapacity,
+		size_t *resultSize
+) {
+	// no bounds needed, use the whole array decoder
+	if (resultCapacity >= msnumpress_decode_bound(codec, dataSize)) {
+		*resultSize = decode(cvCodec(codec), data, dataSize, result, 
+				context->streamingThreshold, streamBuffer(context));
+		return MSNUMPRESS_OK;
+	}
+
+	BlockDecoder decoder;
+	double extra;
+	initBlockDecoder(&decoder, descriptor(codec).codec, data, dataSize, true);
+	*resultSize = decodeBlock(&decoder, result, resultCapacity);
+	if (!decoder.finished && decodeBlock(&decoder, &extra, 1) > 0)
+		return MSNUMPRESS_ERROR_BUFFER;
+	return MSNUMPRESS_OK;
+}
+
+
+
+extern "C" {
+
+msnumpress_context *msnumpress_context_new(void) {
+	return new (std::nothrow) msnumpress_context();
+}
+
+
+
+void msnumpress_context_free(
+		msnumpress_context *context
+) {
+	delete context;
+}
+
+
+
+const char *msnumpress_last_error(
+		const msnumpress_context *context
+) {
+	return context == NULL ? "" : context->error.c_str();
+}
+
+
+
+void msnumpress_set_streaming_threshold(
+		msnumpress_context *context,
+		size_t streamingThreshold
+) {
+	if (context != NULL) context->streamingThreshold = streamingThreshold;
+}
+
+
+
+size_t msnumpress_encode_bound(
+		msnumpress_codec codec,
+		size_t dataSize
+) {
+	return validCodec(codec) ? descriptor(codec).encodeBound(dataSize) : 0;
+}
+
+
+
+size_t msnumpress_decode_bound(
+		msnumpress_codec codec,
+		size_t dataSize
+) {
+	return validCodec(codec) ? descriptor(codec).decodeBound(dataSize) : 0;
+}
+
+
+
+msnumpress_status msnumpress_codec_from_accession(
+		const char *accession,
+		msnumpress_codec *codec,
+		int *zlib
+) {
+	CvCodec cvCodec = resolveCvAccession(accession);
+	if (cvCodec == CV_UNKNOWN || codec == NULL) 
+		return MSNUMPRESS_ERROR_ARGUMENT;
+
+	const CodecDescriptor &d = codecDescriptor(cvCodec);
+	*codec = cCodec(d.codec);
+	if (zlib != NULL) *zlib = d.zlib ? 1 : 0;
+	return MSNUMPRESS_OK;
+}
+
+
+
+double msnumpress_optimal_fixed_point(
+		msnumpress_codec codec,
+		const double *data,
+		size_t dataSize
+) {
+	if (data == NULL || dataSize == 0) return 0;
+	if (!validCodec(codec)) return 0;
+	return descriptor(codec).optimalFixedPoint(data, dataSize);
+}
+
+
+
+msnumpress_status msnumpress_encode(
+		msnumpress_context *context,
+		msnumpress_codec codec,
+		const double *data,
+		size_t dataSize,
+		double fixedPoint,
+		unsigned char *result,
+		size_t resultCapacity,
+		size_t *resultSize
+) {
+	if (context == NULL || (data == NULL && dataSize > 0) || result == NULL ||
+			resultSize == NULL || !validCodec(codec))
+		return fail(context, MSNUMPRESS_ERROR_ARGUMENT, "[msnumpress_encode] Invalid argument.");
+	if (resultCapacity < msnumpress_encode_bound(codec, dataSize))
+		return fail(context, MSNUMPRESS_ERROR_BUFFER, "[msnumpress_encode] Result capacity below msnumpress_encode_bound.");
+
+	try {
+		*resultSize = descriptor(codec).encode(data, dataSize, result, fixedPoint);
+	} catch (const char *err) {
+		return fail(context, MSNUMPRESS_ERROR_DATA, err);
+	} catch (const std::bad_alloc &) {
+		return fail(context, MSNUMPRESS_ERROR_MEMORY, "[msnumpress_encode] Out of memory.");
+	} catch (...) {
+		return fail(context, MSNUMPRESS_ERROR_INTERNAL, "[msnumpress_encode] Unexpected error.");
+	}
+	context->error.clear();
+	return MSNUMPRESS_OK;
+}
+
+
+
+msnumpress_status msnumpress_decode(
+		msnumpress_context *context,
+		msnumpress_codec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		double *result,
+		size_t resultCapacity,
+		size_t *resultSize
+) {
+	msnumpress_status status;
+
+	if (context == NULL || (data == NULL && dataSize > 0) ||
+			(result == NULL && resultCapacity > 0) || resultSize == NULL || !validCodec(codec))
+		return fail(context, MSNUMPRESS_ERROR_ARGUMENT, "[msnumpress_decode] Invalid argument.");
+
+	*resultSize = 0;
+	try {
+		status = decodeBounded(context, codec, data, dataSize, result, resultCapacity, resultSize);
+	} catch (const char *err) {
+		return fail(context, MSNUMPRESS_ERROR_DATA, err);
+	} catch (const std::bad_alloc &) {
+		return fail(context, MSNUMPRESS_ERROR_MEMORY, "[msnumpress_decode] Out of memory.");
+	} catch (...) {
+		return fail(context, MSNUMPRESS_ERROR_INTERNAL, "[msnumpress_decode] Unexpected error.");
+	}
+	if (status == MSNUMPRESS_ERROR_BUFFER)
+		return fail(context, status, "[msnumpress_decode] Result capacity too small.");
+	context->error.clear();
+	return MSNUMPRESS_OK;
+}
+
+
+
+msnumpress_status msnumpress_decode_batch(
+		msnumpress_context *context,
+		msnumpress_codec codec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		double *result,
+		size_t resultCapacity,
+		size_t *offsets
+) {
+	msnumpress_status status;
+	size_t i, decoded, bound;
+
+	if (context == NULL || (count > 0 && (data == NULL || dataSizes == NULL)) ||
+			(result == NULL && resultCapacity > 0) || offsets == NULL || !validCodec(codec))
+		return fail(context, MSNUMPRESS_ERROR_ARGUMENT, "[msnumpress_decode_batch] Invalid argument.");
+
+	// with room for every array, dispatch once for the whole batch
+	for (i=0, bound=0; i<count; i++) {
+		bound += msnumpress_decode_bound(codec, dataSizes[i]);
+	}
+	if (bound <= resultCapacity) {
+		try {
+			decodeBatch(cvCodec(codec), data, dataSizes, count, result, offsets, 
+					context->streamingThreshold, streamBuffer(context));
+			context->error.clear();
+			return MSNUMPRESS_OK;
+		} catch (...) {
+			// redo array by array below, to report the failing array
+		}
+	}
+
+	offsets[0] = 0;
+	for (i=0; i<count; i++) {
+		status = msnumpress_decode(context, codec, data[i], dataSizes[i],
+				result == NULL ? NULL : result + offsets[i], resultCapacity - offsets[i], &decoded);
+		if (status != MSNUMPRESS_OK) return status;
+		offsets[i+1] = offsets[i] + decoded;
+	}
+	return MSNUMPRESS_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,169 @@
+/*
+	MSNumpressC.h
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+/*
+	==================== C interface ====================
+	A stable C ABI over the C++ implementation, for foreign function
+	interfaces (JNI/Panama, P/Invoke, ctypes) working on their own memory.
+
+	- All arrays are passed as pointer and length, and results are written
+	  straight into caller memory of a given capacity, without copies.
+	- No exception crosses the interface: functions return an
+	  msnumpress_status, and the message of the last error is kept in the
+	  opaque context passed to every call.
+	- A context must not be used by several threads at once, so use one
+	  context per thread.
+ */
+
+#ifndef _MSNUMPRESS_C_H_
+#define _MSNUMPRESS_C_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msnumpress_context msnumpress_context;
+
+typedef enum {
+	MSNUMPRESS_OK 				= 0,
+	MSNUMPRESS_ERROR_ARGUMENT 	= 1,	/* NULL pointer or unknown codec */
+	MSNUMPRESS_ERROR_DATA 		= 2,	/* corrupt input, or values that cannot be encoded */
+	MSNUMPRESS_ERROR_BUFFER 	= 3,	/* output capacity too small */
+	MSNUMPRESS_ERROR_MEMORY 	= 4,
+	MSNUMPRESS_ERROR_INTERNAL 	= 5
+} msnumpress_status;
+
+/* same values as ms::numpress::MSNumpress::BlockCodec */
+typedef enum {
+	MSNUMPRESS_LINEAR 	= 0,
+	MSNUMPRESS_PIC 		= 1,
+	MSNUMPRESS_SLOF 	= 2
+} msnumpress_codec;
+
+/**
+ * Creates a context, or returns NULL if out of memory.
+ */
+msnumpress_context *msnumpress_context_new(void);
+
+void msnumpress_context_free(msnumpress_context *context);
+
+/**
+ * The message of the last error in context, or "" if the last call
+ * succeeded. Valid until the next call with context.
+ */
+const char *msnumpress_last_error(const msnumpress_context *context);
+
+/**
+ * Makes msnumpress_decode and msnumpress_decode_batch store values with
+ * non-temporal stores, bypassing the cache, for outputs with a decode bound
+ * of at least streamingThreshold bytes of doubles, see the C++ decodeBatch.
+ * This is for outputs much larger than the cache that are not read back
+ * right away. The default 0 never streams. A streaming context keeps the
+ * 256kB buffer values are decoded through for all its later calls.
+ */
+void msnumpress_set_streaming_threshold(msnumpress_context *context, size_t streamingThreshold);
+
+/**
+ * The number of bytes needed for encoding dataSize values with codec.
+ */
+size_t msnumpress_encode_bound(msnumpress_codec codec, size_t dataSize);
+
+/**
+ * An upper bound of the number of values decoded from dataSize bytes
+ * encoded with codec, exact for Slof.
+ */
+size_t msnumpress_decode_bound(msnumpress_codec codec, size_t dataSize);
+
+/**
+ * Resolves a PSI-MS accession such as "MS:1002312" to its codec, setting
+ * *zlib (if not NULL) to 1 for the "followed by zlib compression" terms,
+ * whose data must be inflated before decoding. Returns
+ * MSNUMPRESS_ERROR_ARGUMENT for other accessions.
+ */
+msnumpress_status msnumpress_codec_from_accession(
+	const char *accession,
+	msnumpress_codec *codec,
+	int *zlib);
+
+/**
+ * The optimal fixed point for encoding data with codec, as from
+ * optimalLinearFixedPoint or optimalSlofFixedPoint, or 0 for Pic.
+ */
+double msnumpress_optimal_fixed_point(
+	msnumpress_codec codec,
+	const double *data,
+	size_t dataSize);
+
+/**
+ * Encodes dataSize doubles from data with codec into result, which must
+ * hold at least msnumpress_encode_bound(codec, dataSize) bytes.
+ *
+ * @fixedPoint	the scaling factor, ignored by Pic
+ * @resultSize	set to the number of encoded bytes
+ */
+msnumpress_status msnumpress_encode(
+	msnumpress_context *context,
+	msnumpress_codec codec,
+	const double *data,
+	size_t dataSize,
+	double fixedPoint,
+	unsigned char *result,
+	size_t resultCapacity,
+	size_t *resultSize);
+
+/**
+ * Decodes dataSize bytes encoded with codec into result. If the values do
+ * not fit into resultCapacity doubles, MSNUMPRESS_ERROR_BUFFER is returned,
+ * after filling result. A capacity of msnumpress_decode_bound(codec, dataSize)
+ * is always enough.
+ *
+ * @resultSize	set to the number of decoded doubles
+ */
+msnumpress_status msnumpress_decode(
+	msnumpress_context *context,
+	msnumpress_codec codec,
+	const unsigned char *data,
+	size_t dataSize,
+	double *result,
+	size_t resultCapacity,
+	size_t *resultSize);
+
+/**
+ * Decodes count arrays encoded with codec, array i being dataSizes[i] bytes
+ * at data[i], one after the other into result. The values of array i are
+ * stored from result[offsets[i]] to result[offsets[i+1] - 1], so offsets
+ * must hold count + 1 entries. On error, the arrays before the failing one
+ * are decoded and their offsets set.
+ */
+msnumpress_status msnumpress_decode_batch(
+	msnumpress_context *context,
+	msnumpress_codec codec,
+	const unsigned char * const *data,
+	const size_t *dataSizes,
+	size_t count,
+	double *result,
+	size_t resultCapacity,
+	size_t *offsets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MSNUMPRESS_C_H_ */
@@ -0,0 +1,544 @@
+/*
+	MSNumpressCache.cpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include "MSNumpressCache.hpp"
+
+namespace ms {
+namespace numpress {
+namespace MSNumpress {
+
+using std::min;
+using std::max;
+
+/**
+ * splitmix64 finalizer
+ */
+static unsigned long long mix64(
+		unsigned long long x
+) {
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+
+
+size_t CacheKeyHash::operator()(
+		const CacheKey &key
+) const {
+	return static_cast<size_t>(mix64(key.id * 0x9E3779B97F4A7C15ULL + key.index));
+}
+
+
+
+static std::atomic<unsigned long long> nextCacheId(1);
+
+unsigned long long newCacheId() {
+	return nextCacheId++;
+}
+
+
+
+CacheKey encodedCacheKey(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize
+) {
+	// two independent multiplicative hashes over 8 byte words
+	unsigned long long h1 = 0x243F6A8885A308D3ULL ^ dataSize;
+	unsigned long long h2 = 0x13198A2E03707344ULL + codec;
+	unsigned long long w;
+	size_t i;
+
+	for (i=0; i+8<=dataSize; i+=8) {
+		memcpy(&w, &data[i], 8);
+		h1 = (h1 ^ w) * 0x9E3779B97F4A7C15ULL;
+		h1 = (h1 << 31) | (h1 >> 33);
+		h2 = (h2 + w) * 0xC2B2AE3D27D4EB4FULL;
+		h2 = (h2 << 29) | (h2 >> 35);
+	}
+	w = 0;
+	for (; i<dataSize; i++) {
+		w = (w << 8) | data[i];
+	}
+	h1 = (h1 ^ w) * 0x9E3779B97F4A7C15ULL;
+	h2 = (h2 + w) * 0xC2B2AE3D27D4EB4FULL;
+
+	CacheKey key = { mix64(h1 + codec), mix64(h2 ^ dataSize) };
+	return key;
+}
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+DecodedCache::DecodedCache(
+		size_t maxBytes,
+		size_t shardCount
+) :
+		budget(maxBytes),
+		used(0),
+		nextShard(0)
+{
+	shardCount = max(shardCount, static_cast<size_t>(1));
+	for (size_t i=0; i<shardCount; i++) {
+		shards.push_back(std::unique_ptr<Shard>(new Shard()));
+		shards[i]->used = 0;
+	}
+	resetStats();
+}
+
+
+
+DecodedCache &DecodedCache::instance() {
+	static DecodedCache cache(DEFAULT_CACHE_BYTES);
+	return cache;
+}
+
+
+
+DecodedCache::Shard &DecodedCache::shard(
+		const CacheKey &key
+) {
+	// high bits, as the low bits pick the bucket in the shard
+	unsigned long long h = mix64(key.id ^ mix64(key.index));
+	return *shards[static_cast<size_t>((h >> 32) % shards.size())];
+}
+
+
+
+DecodedBlock DecodedCache::get(
+		const CacheKey &key
+) {
+	Shard &s = shard(key);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto it = s.index.find(key);
+	if (it == s.index.end()) {
+		s.misses++;
+		return DecodedBlock();
+	}
+
+	s.hits++;
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+	return it->second->block;
+}
+
+
+
+void DecodedCache::put(
+		const CacheKey &key,
+		const DecodedBlock &block
+) {
+	size_t blockBytes = block->size() * sizeof(double);
+	Shard &s = shard(key);
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		auto it = s.index.find(key);
+		if (it != s.index.end()) {
+			size_t oldBytes = it->second->block->size() * sizeof(double);
+			s.used -= oldBytes;
+			used -= oldBytes;
+			s.lru.erase(it->second);
+			s.index.erase(it);
+		}
+		if (blockBytes > budget) return;
+
+		Entry entry = { key, block };
+		s.lru.push_front(entry);
+		s.index[key] = s.lru.begin();
+		s.used += blockBytes;
+		used += blockBytes;
+		s.insertions++;
+
+		while (used > budget && s.lru.size() > 1) dropLast(s);
+		if (used <= budget) return;
+	}
+	// only if s holds nothing but the new block, without the lock of s
+	evict(&s);
+}
+
+
+
+void DecodedCache::setMaxBytes(
+		size_t maxBytes
+) {
+	budget = maxBytes;
+	evict(NULL);
+}
+
+
+
+size_t DecodedCache::maxBytes() const {
+	return budget;
+}
+
+
+
+size_t DecodedCache::bytes() const {
+	return stats().bytes;
+}
+
+
+
+CacheStats DecodedCache::stats() const {
+	CacheStats stats = { 0, 0, 0, 0, 0, 0 };
+	for (size_t i=0; i<shards.size(); i++) {
+		Shard &s = *shards[i];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		stats.hits 			+= s.hits;
+		stats.misses 		+= s.misses;
+		stats.insertions 	+= s.insertions;
+		stats.evictions 	+= s.evictions;
+		stats.bytes 		+= s.used;
+		stats.entries 		+= s.index.size();
+	}
+	return stats;
+}
+
+
+
+void DecodedCache::resetStats() {
+	for (size_t i=0; i<shards.size(); i++) {
+		Shard &s = *shards[i];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.hits = s.misses = s.insertions = s.evictions = 0;
+	}
+}
+
+
+
+void DecodedCache::clear() {
+	for (size_t i=0; i<shards.size(); i++) {
+		Shard &s = *shards[i];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		used -= s.used;
+		s.lru.clear();
+		s.index.clear();
+		s.used = 0;
+	}
+}
+
+
+
+/**
+ * Drops the least recently used block of s, with the lock of s held.
+ */
+void DecodedCache::dropLast(
+		Shard &s
+) {
+	size_t blockBytes = s.lru.back().block->size() * sizeof(double);
+	s.used -= blockBytes;
+	used -= blockBytes;
+	s.index.erase(s.lru.back().key);
+	s.lru.pop_back();
+	s.evictions++;
+}
+
+
+
+/**
+ * Drops the least recently used blocks of the shards in turn while over 
+ * budget, keeping the newest block of inserted. Takes the lock of one shard
+ * at a time, so it must be called without any held. Starting at a rotating
+ * shard spreads the evictions over all shards.
+ */
+void DecodedCache::evict(
+		Shard *inserted
+) {
+	for (size_t i=0; i<shards.size() && used > budget; i++) {
+		Shard &s = *shards[nextShard++ % shards.size()];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		size_t keep = &s == inserted ? 1 : 0;
+		while (used > budget && s.lru.size() > keep) dropLast(s);
+	}
+}
+
+
+
+/////////////////////////////////////////////////////////////
+
+
+LazyDecodedArray::LazyDecodedArray(
+		BlockCodec codec,
+		std::vector<unsigned char> &data,
+		DecodedCache &cache
+) :
+		cache(&cache)
+{
+	this->data.swap(data);
+	init(codec);
+}
+
+
+
+LazyDecodedArray::LazyDecodedArray(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		DecodedCache &cache
+) :
+		data(data, data + dataSize),
+		cache(&cache)
+{
+	init(codec);
+}
+
+
+
+void LazyDecodedArray::init(
+		BlockCodec codec
+) {
+	this->codec = codec;
+	id = newCacheId();
+	sizeKnown = false;
+	count = 0;
+	currentIndex = 0;
+
+	BlockDecoder decoder;
+	initBlockDecoder(&decoder, codec, data.empty() ? NULL : &data[0], data.size(), true);
+
+	if (codec == BLOCK_SLOF) {
+		// reads the fixed point only
+		decodeBlock(&decoder, NULL, 0);
+		if ((data.size() - 8) % 2 != 0)
+			throw "[MSNumpress::LazyDecodedArray] Corrupt input data: odd number of Slof bytes! ";
+		sizeKnown = true;
+		count = (data.size() - 8) / 2;
+	}
+	checkpoints.push_back(decoder);
+}
+
+
+
+/**
+ * Decodes the block after the last checkpoint, storing the checkpoint after
+ * it, or returns false if that is the end of the array.
+ */
+bool LazyDecodedArray::extend() const {
+	BlockDecoder decoder;
+	double scratch[LAZY_BLOCK_SIZE];
+
+	if (sizeKnown) return false;
+
+	decoder = checkpoints.back();
+	decoder.data = data.empty() ? NULL : &data[0];
+	if (decodeBlock(&decoder, scratch, LAZY_BLOCK_SIZE) < LAZY_BLOCK_SIZE || decoder.finished) {
+		sizeKnown = true;
+		count = decoder.count;
+		return false;
+	}
+	checkpoints.push_back(decoder);
+	return true;
+}
+
+
+
+/**
+ * The decoder state at the start of block b, decoding and storing the
+ * checkpoints up to it as needed.
+ */
+BlockDecoder LazyDecodedArray::checkpoint(
+		size_t b
+) const {
+	BlockDecoder decoder;
+
+	if (codec == BLOCK_SLOF) {
+		if (b * LAZY_BLOCK_SIZE >= count)
+			throw "[MSNumpress::LazyDecodedArray] Index out of range! ";
+		decoder = checkpoints[0];
+		decoder.di = 8 + 2 * b * LAZY_BLOCK_SIZE;
+		decoder.count = b * LAZY_BLOCK_SIZE;
+	} else {
+		while (checkpoints.size() <= b && extend()) {}
+		if (b >= checkpoints.size())
+			throw "[MSNumpress::LazyDecodedArray] Index out of range! ";
+		decoder = checkpoints[b];
+	}
+	decoder.data = data.empty() ? NULL : &data[0];
+	return decoder;
+}
+
+
+
+DecodedBlock LazyDecodedArray::decode(
+		size_t b
+) const {
+	BlockDecoder decoder = checkpoint(b);
+	std::shared_ptr<std::vector<double> > values(new std::vector<double>(LAZY_BLOCK_SIZE));
+
+	size_t n = decodeBlock(&decoder, &(*values)[0], LAZY_BLOCK_SIZE);
+	if (n == 0)
+		throw "[MSNumpress::LazyDecodedArray] Index out of range! ";
+	values->resize(n);
+	return values;
+}
+
+
+
+DecodedBlock LazyDecodedArray::block(
+		size_t b
+) const {
+	if (current && currentIndex == b) return current;
+
+	CacheKey key = { id, b };
+	DecodedBlock values = cache->get(key);
+	if (!values) {
+		values = decode(b);
+		cache->put(key, values);
+	}
+	current = values;
+	currentIndex = b;
+	return values;
+}
+
+
+
+size_t LazyDecodedArray::size() const {
+	while (extend()) {}
+	return count;
+}
+
+
+
+double LazyDecodedArray::operator[](
+		size_t i
+) const {
+	size_t b = i / LAZY_BLOCK_SIZE;
+	if (!current || currentIndex != b) block(b);
+	return (*current)[i % LAZY_BLOCK_SIZE];
+}
+
+
+
+double LazyDecodedArray::at(
+		size_t i
+) const {
+	if (i >= size())
+		throw "[MSNumpress::LazyDecodedArray] Index out of range! ";
+	return (*this)[i];
+}
+
+
+
+void LazyDecodedArray::copy(
+		size_t first,
+		size_t last,
+		double *result
+) const {
+	size_t b, offset, n;
+
+	while (first < last) {
+		b = first / LAZY_BLOCK_SIZE;
+		offset = first % LAZY_BLOCK_SIZE;
+		DecodedBlock values = block(b);
+		if (values->size() <= offset)
+			throw "[MSNumpress::LazyDecodedArray] Index out of range! ";
+		n = min(values->size() - offset, last - first);
+		std::copy(values->begin() + offset, values->begin() + offset + n, result);
+		result += n;
+		first += n;
+	}
+}
+
+
+
+size_t LazyDecodedArray::residentBytes() const {
+	return sizeof(*this) + data.capacity() + checkpoints.capacity() * sizeof(BlockDecoder);
+}
+
+/////////////////////////////////////////////////////////////
+
+
+DecodedBlock decodeCached(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		const CacheKey &key,
+		DecodedCache &cache
+) {
+	DecodedBlock values = cache.get(key);
+	if (values) return values;
+
+	std::shared_ptr<std::vector<double> > decoded(new std::vector<double>());
+	BlockDecoder decoder;
+	size_t n;
+
+	// slof size is known, others grow a block at a time
+	decoded->reserve((codec == BLOCK_SLOF && dataSize >= 8 ? (dataSize - 8) / 2 : 0) + LAZY_BLOCK_SIZE);
+	initBlockDecoder(&decoder, codec, data, dataSize, true);
+	do {
+		n = decoded->size();
+		decoded->resize(n + LAZY_BLOCK_SIZE);
+		n += decodeBlock(&decoder, &(*decoded)[n], LAZY_BLOCK_SIZE);
+		decoded->resize(n);
+	} while (!decoder.finished);
+
+	decoded->shrink_to_fit();
+	cache.put(key, decoded);
+	return decoded;
+}
+
+
+
+DecodedBlock decodeCached(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		DecodedCache &cache
+) {
+	return decodeCached(codec, data, dataSize, encodedCacheKey(codec, data, dataSize), cache);
+}
+
+
+
+void decodeCached(
+		BlockCodec codec,
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result,
+		DecodedCache &cache
+) {
+	DecodedBlock values = decodeCached(codec, data.empty() ? NULL : &data[0], data.size(), cache);
+	result.assign(values->begin(), values->end());
+}
+
+
+
+void decodeBatchCached(
+		BlockCodec codec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		const CacheKey *keys,
+		DecodedBlock *results,
+		DecodedCache &cache
+) {
+	for (size_t i=0; i<count; i++) {
+		results[i] = decodeCached(codec, data[i], dataSizes[i], 
+				keys == NULL ? encodedCacheKey(codec, data[i], dataSizes[i]) : keys[i], cache);
+	}
+}
+
+} // namespace MSNumpress
+} // namespace numpress
+} // namespace ms
@@ -0,0 +1,361 @@
+/*
+	MSNumpressCache.hpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+/*
+	==================== decoded caches ====================
+	Keeping decoded values of encoded arrays in memory only while they are
+	used. Unlike MSNumpress.hpp, this part needs C++11.
+
+	A DecodedCache holds decoded blocks of values up to a byte budget,
+	evicting the least recently used blocks first. decodeCached looks whole
+	arrays up in a DecodedCache before decoding. A LazyDecodedArray wraps
+	an encoded array and decodes the blocks it is accessed in on first use,
+	keeping them in a DecodedCache shared by all arrays, so resident memory
+	tracks the working set rather than the full decoded size.
+
+	The decoders of MSNumpress.hpp do not consult a cache themselves: they
+	stay C++98 and free of locks and allocations, and a bare pointer to
+	encoded bytes has no cheap identity to key on. Callers that want
+	caching use decodeCached and decodeBatchCached in their place.
+ */
+
+#ifndef _MSNUMPRESS_CACHE_HPP_
+#define _MSNUMPRESS_CACHE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "MSNumpress.hpp"
+
+namespace ms {
+namespace numpress {
+
+namespace MSNumpress {
+
+	/**
+	 * Identity of a decoded block in a DecodedCache.
+	 */
+	struct CacheKey {
+		unsigned long long id;		// identity of the encoded array
+		unsigned long long index;	// block within the array
+
+		bool operator==(const CacheKey &other) const {
+			return id == other.id && index == other.index;
+		}
+	};
+
+	struct CacheKeyHash {
+		size_t operator()(const CacheKey &key) const;
+	};
+
+	typedef std::shared_ptr<const std::vector<double> > DecodedBlock;
+
+	/**
+	 * Counters of a DecodedCache, for tuning its budget.
+	 */
+	struct CacheStats {
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long insertions;
+		unsigned long long evictions;
+		size_t bytes;		// bytes of decoded values held
+		size_t entries;		// number of blocks held
+	};
+
+	/**
+	 * Default number of shards of a DecodedCache.
+	 */
+	const size_t CACHE_SHARDS = 16;
+
+	/**
+	 * Thread safe cache of decoded blocks, evicting least recently used
+	 * blocks once the decoded values exceed the byte budget. Blocks are
+	 * handed out as shared pointers, so evicted blocks stay valid while used.
+	 *
+	 * Keys are spread over shards with a lock each, so threads rarely wait
+	 * for each other. The budget is shared by all shards, but eviction is 
+	 * per shard: once the budget is exceeded, put evicts the least recently
+	 * used blocks of the shard it inserted into, under the lock it already
+	 * holds, and only moves on to the other shards in turn, one lock at a 
+	 * time, if that shard holds nothing else. The order of eviction is so 
+	 * least recently used within a shard, and approximately so across the 
+	 * cache. Any working set within the budget stays cached however its keys
+	 * fall into shards. A block larger than the budget is not kept.
+	 */
+	class DecodedCache {
+	public:
+		/**
+		 * @maxBytes	the budget for decoded values held in the cache
+		 * @shards		the number of independently locked shards
+		 */
+		explicit DecodedCache(size_t maxBytes, size_t shards = CACHE_SHARDS);
+
+		/**
+		 * The per-process cache used by default, with a budget of
+		 * DEFAULT_CACHE_BYTES.
+		 */
+		static DecodedCache &instance();
+
+		/**
+		 * Returns the block stored for key, marking it as most recently used,
+		 * or an empty pointer if it is not in the cache.
+		 */
+		DecodedBlock get(const CacheKey &key);
+
+		/**
+		 * Stores block for key, replacing any block stored before, and evicts
+		 * least recently used blocks while over the byte budget.
+		 */
+		void put(const CacheKey &key, const DecodedBlock &block);
+
+		/**
+		 * Changes the byte budget, evicting blocks if needed.
+		 */
+		void setMaxBytes(size_t maxBytes);
+
+		size_t maxBytes() const;
+
+		/**
+		 * Bytes of decoded values currently in the cache.
+		 */
+		size_t bytes() const;
+
+		/**
+		 * Sums of the counters of all shards.
+		 */
+		CacheStats stats() const;
+
+		/**
+		 * Zeroes the hit, miss, insertion and eviction counters.
+		 */
+		void resetStats();
+
+		void clear();
+
+	private:
+		struct Entry {
+			CacheKey key;
+			DecodedBlock block;
+		};
+
+		typedef std::list<Entry> Lru;
+
+		struct Shard {
+			std::mutex mutex;
+			size_t used;
+			Lru lru;	// most recently used first
+			std::unordered_map<CacheKey, Lru::iterator, CacheKeyHash> index;
+			unsigned long long hits;
+			unsigned long long misses;
+			unsigned long long insertions;
+			unsigned long long evictions;
+		};
+
+		Shard &shard(const CacheKey &key);
+		void dropLast(Shard &s);
+		void evict(Shard *inserted);
+
+		std::atomic<size_t> budget;
+		std::atomic<size_t> used;		// bytes of all shards
+		std::atomic<size_t> nextShard;	// where evict starts
+		std::vector<std::unique_ptr<Shard> > shards;
+
+		DecodedCache(const DecodedCache &);
+		DecodedCache &operator=(const DecodedCache &);
+	};
+
+	/**
+	 * Returns a new id for CacheKey.id, never returned before in this
+	 * process. Containers of arrays keyed as (container id, array index)
+	 * should take their id from here, as LazyDecodedArray does, so that
+	 * keys never clash.
+	 */
+	unsigned long long newCacheId();
+
+	/**
+	 * Key identifying data encoded with codec by a 128 bit hash of the bytes,
+	 * for arrays without a container identity. Different data getting the
+	 * same key is astronomically unlikely, but possible.
+	 */
+	CacheKey encodedCacheKey(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize);
+
+	/**
+	 * Byte budget of DecodedCache::instance().
+	 */
+	const size_t DEFAULT_CACHE_BYTES = 64 << 20;
+
+	/**
+	 * Number of values in a block of a LazyDecodedArray.
+	 */
+	const size_t LAZY_BLOCK_SIZE = 256;
+
+	/**
+	 * An array encoded by encodeLinear, encodePic or encodeSlof, which is
+	 * decoded a block of LAZY_BLOCK_SIZE values at a time on first access.
+	 * Decoded blocks are kept in a DecodedCache.
+	 *
+	 * Lin and Pic can only be decoded from the start, so the decoder state
+	 * at the start of each block is stored as a checkpoint when the array is
+	 * first decoded up to it, and blocks are later decoded from their
+	 * checkpoint. Slof blocks are decoded directly from their offset.
+	 *
+	 * Values are identical to those of decodeLinear, decodePic or decodeSlof.
+	 * Accessors may throw a const char* if the encoded data is corrupt. One
+	 * array must not be used from several threads at once, but different
+	 * arrays may share a cache across threads.
+	 */
+	class LazyDecodedArray {
+	public:
+		/**
+		 * @codec	the encoding of data
+		 * @data	the encoded bytes, swapped into the array
+		 * @cache	the cache to keep decoded blocks in, which must outlive
+		 *			the array
+		 */
+		LazyDecodedArray(
+			BlockCodec codec,
+			std::vector<unsigned char> &data,
+			DecodedCache &cache = DecodedCache::instance());
+
+		LazyDecodedArray(
+			BlockCodec codec,
+			const unsigned char *data,
+			size_t dataSize,
+			DecodedCache &cache = DecodedCache::instance());
+
+		/**
+		 * The number of values, which for Lin and Pic needs decoding the
+		 * whole array once, without keeping the values.
+		 */
+		size_t size() const;
+
+		/**
+		 * Value i, decoding its block if it is not cached.
+		 */
+		double operator[](size_t i) const;
+
+		/**
+		 * Same as operator[], but throws if i is not less than size().
+		 */
+		double at(size_t i) const;
+
+		/**
+		 * Stores values first to last - 1 in result, decoding blocks as needed.
+		 * Throws if last is larger than size().
+		 */
+		void copy(size_t first, size_t last, double *result) const;
+
+		/**
+		 * Block b of values, decoding it if it is not cached.
+		 */
+		DecodedBlock block(size_t b) const;
+
+		/**
+		 * Bytes held by the array itself, the encoded data and the
+		 * checkpoints, not counting cached blocks.
+		 */
+		size_t residentBytes() const;
+
+	private:
+		void init(BlockCodec codec);
+		bool extend() const;
+		BlockDecoder checkpoint(size_t b) const;
+		DecodedBlock decode(size_t b) const;
+
+		std::vector<unsigned char> data;
+		DecodedCache *cache;
+		unsigned long long id;
+		BlockCodec codec;
+
+		// known block starts, and the number of values once known
+		mutable std::vector<BlockDecoder> checkpoints;
+		mutable bool sizeKnown;
+		mutable size_t count;
+
+		// last accessed block, saving cache lookups on sequential access
+		mutable DecodedBlock current;
+		mutable size_t currentIndex;
+	};
+
+	/**
+	 * Decodes data encoded by encodeLinear, encodePic or encodeSlof, or 
+	 * returns the values cached for key. Decoded arrays are put in cache.
+	 *
+	 * Note that this method may throw a const char* if it deems the input data to be corrupt.
+	 *
+	 * @codec		the encoding of data
+	 * @data		pointer to array of bytes to be decoded (need memorycont. repr.)
+	 * @dataSize	number of bytes from *data to decode
+	 * @key			identity of data, such as (newCacheId() of the file, array 
+	 *				index) or encodedCacheKey(codec, data, dataSize)
+	 * @cache		the cache to consult
+	 * @return		the decoded values, shared with the cache
+	 */
+	DecodedBlock decodeCached(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		const CacheKey &key,
+		DecodedCache &cache = DecodedCache::instance());
+
+	/**
+	 * Calls decodeCached keyed by encodedCacheKey(codec, data, dataSize).
+	 */
+	DecodedBlock decodeCached(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		DecodedCache &cache = DecodedCache::instance());
+
+	/**
+	 * Calls decodeCached keyed by encodedCacheKey, copying the values into
+	 * result (which will be resized to the number of doubles)
+	 */
+	void decodeCached(
+		BlockCodec codec,
+		const std::vector<unsigned char> &data,
+		std::vector<double> &result,
+		DecodedCache &cache = DecodedCache::instance());
+
+	/**
+	 * Calls decodeCached for count arrays encoded with the same codec, keyed
+	 * by keys, or by encodedCacheKey if keys is NULL.
+	 *
+	 * @results		pointer to where the count decoded arrays should be stored
+	 */
+	void decodeBatchCached(
+		BlockCodec codec,
+		const unsigned char * const *data,
+		const size_t *dataSizes,
+		size_t count,
+		const CacheKey *keys,
+		DecodedBlock *results,
+		DecodedCache &cache = DecodedCache::instance());
+
+} // namespace MSNumpress
+} // namespace msdata
+} // namespace pwiz
+
+#endif // _MSNUMPRESS_CACHE_HPP_
@@ -0,0 +1,302 @@
+/*
+	MSNumpressCoro.hpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+/*
+	==================== coroutine generators ====================
+	Header only C++20 wrappers around the BlockDecoder of MSNumpress.hpp, for
+	chaining processing stages (decode -> filter -> centroid -> score) block
+	by block, with memory bounded by the block size and without a thread
+	per stage.
+
+		for (std::span<const double> block : decodeBlocks(BLOCK_SLOF, data, size))
+			...
+
+	decodeBlocksAsync reads the encoded bytes from an asynchronous source,
+	such as an inflate stream or a file read, by co_await source.read().
+	read() must return an awaitable giving a std::span<const unsigned char>
+	holding the next bytes, which stay valid until the next read, and an empty
+	span at the end of the data. Consumers co_await next() on the generator:
+
+		AsyncGenerator<std::span<const double> > blocks = decodeBlocksAsync(BLOCK_LINEAR, source);
+		while (const std::span<const double> *block = co_await blocks.next())
+			...
+
+	Blocks handed out stay valid until the generator is resumed.
+	Exceptions thrown while decoding, const char* as in the rest of
+	MSNumpress, propagate to the consumer.
+ */
+
+#ifndef _MSNUMPRESS_CORO_HPP_
+#define _MSNUMPRESS_CORO_HPP_
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+#include "MSNumpress.hpp"
+
+namespace ms {
+namespace numpress {
+namespace MSNumpress {
+
+	/**
+	 * Default number of values per block, 2kB of doubles to stay in L1 cache.
+	 */
+	const size_t CORO_BLOCK_SIZE = 256;
+
+	/**
+	 * Synchronous generator of T, iterated with a range for loop.
+	 */
+	template <class T>
+	class Generator {
+	public:
+		struct promise_type {
+			const T *current = nullptr;
+			std::exception_ptr exception;
+
+			Generator get_return_object() {
+				return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			std::suspend_always yield_value(const T &value) noexcept {
+				current = &value;
+				return {};
+			}
+			void return_void() noexcept {}
+			void unhandled_exception() { exception = std::current_exception(); }
+		};
+
+		class iterator {
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() = default;
+			explicit iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+			const T &operator*() const { return *handle.promise().current; }
+			const T *operator->() const { return handle.promise().current; }
+			iterator &operator++() {
+				advance(handle);
+				return *this;
+			}
+			void operator++(int) { ++*this; }
+			bool operator==(std::default_sentinel_t) const { return !handle || handle.done(); }
+
+		private:
+			std::coroutine_handle<promise_type> handle;
+		};
+
+		Generator(Generator &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		Generator &operator=(Generator &&other) noexcept {
+			std::swap(handle, other.handle);
+			return *this;
+		}
+		~Generator() { if (handle) handle.destroy(); }
+
+		iterator begin() {
+			advance(handle);
+			return iterator(handle);
+		}
+		std::default_sentinel_t end() { return std::default_sentinel; }
+
+	private:
+		explicit Generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+		static void advance(std::coroutine_handle<promise_type> handle) {
+			handle.resume();
+			if (handle.promise().exception)
+				std::rethrow_exception(handle.promise().exception);
+		}
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+
+
+	/**
+	 * Asynchronous generator of T. The generator body may co_await other
+	 * awaitables between co_yields, and is resumed by the consumer's
+	 * co_await next(), which gives a pointer to the next value, or nullptr
+	 * at the end.
+	 *
+	 * next() resumes the generator from within the consumer's await_suspend,
+	 * and if the generator yields before suspending on anything else, the 
+	 * consumer goes on without having suspended. Only a generator resumed by 
+	 * something else, as an asynchronous source, resumes the consumer itself. 
+	 * So a source that never suspends does not nest a stack frame per value, 
+	 * as symmetric transfer would without guaranteed tail calls (at -O0, or 
+	 * with AddressSanitizer).
+	 */
+	template <class T>
+	class AsyncGenerator {
+	public:
+		/**
+		 * Who continues the consumer: the generator was resumed by next() 
+		 * and has not yielded yet (RUNNING), has yielded to next() 
+		 * (YIELDED), or the consumer suspended and must be resumed by the
+		 * generator (SUSPENDED). Atomic, as a source may resume the generator
+		 * on another thread while next() is deciding whether to suspend.
+		 */
+		enum State { RUNNING, YIELDED, SUSPENDED };
+
+		struct promise_type {
+			const T *current = nullptr;
+			std::coroutine_handle<> consumer;
+			std::exception_ptr exception;
+			std::atomic<State> state{YIELDED};
+
+			struct ResumeConsumer {
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+					State running = RUNNING;
+					if (handle.promise().state.compare_exchange_strong(running, YIELDED))
+						return std::noop_coroutine();	// back into next()
+					return handle.promise().consumer;
+				}
+				void await_resume() noexcept {}
+			};
+
+			AsyncGenerator get_return_object() {
+				return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			ResumeConsumer final_suspend() noexcept { return {}; }
+			ResumeConsumer yield_value(const T &value) noexcept {
+				current = &value;
+				return {};
+			}
+			void return_void() noexcept { current = nullptr; }
+			void unhandled_exception() {
+				current = nullptr;
+				exception = std::current_exception();
+			}
+		};
+
+		class NextAwaiter {
+		public:
+			explicit NextAwaiter(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+			bool await_ready() noexcept { return !handle || handle.done(); }
+			bool await_suspend(std::coroutine_handle<> consumer) noexcept {
+				State running = RUNNING;
+				handle.promise().consumer = consumer;
+				handle.promise().state.store(RUNNING);
+				handle.resume();
+				return handle.promise().state.compare_exchange_strong(running, SUSPENDED);
+			}
+			const T *await_resume() {
+				if (!handle) return nullptr;
+				if (handle.promise().exception)
+					std::rethrow_exception(std::exchange(handle.promise().exception, nullptr));
+				return handle.done() ? nullptr : handle.promise().current;
+			}
+
+		private:
+			std::coroutine_handle<promise_type> handle;
+		};
+
+		AsyncGenerator(AsyncGenerator &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		AsyncGenerator &operator=(AsyncGenerator &&other) noexcept {
+			std::swap(handle, other.handle);
+			return *this;
+		}
+		~AsyncGenerator() { if (handle) handle.destroy(); }
+
+		NextAwaiter next() { return NextAwaiter(handle); }
+
+	private:
+		explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+
+
+	/**
+	 * Yields the values of data encoded by encodeLinear, encodePic or
+	 * encodeSlof in blocks of at most blockSize doubles. data must stay
+	 * valid while the generator is used.
+	 */
+	inline Generator<std::span<const double> > decodeBlocks(
+		BlockCodec codec,
+		const unsigned char *data,
+		size_t dataSize,
+		size_t blockSize = CORO_BLOCK_SIZE
+	) {
+		std::vector<double> block(blockSize);
+		BlockDecoder decoder;
+		size_t count;
+
+		initBlockDecoder(&decoder, codec, data, dataSize, true);
+		while ((count = decodeBlock(&decoder, &block[0], blockSize)) > 0) {
+			co_yield std::span<const double>(block.data(), count);
+		}
+	}
+
+
+
+	/**
+	 * Yields the values of data encoded by encodeLinear, encodePic or
+	 * encodeSlof, read from source as described above, in blocks of at most
+	 * blockSize doubles. Only the bytes of a value not yet decoded are kept
+	 * between reads. source must outlive the generator.
+	 */
+	template <class Source>
+	AsyncGenerator<std::span<const double> > decodeBlocksAsync(
+		BlockCodec codec,
+		Source &source,
+		size_t blockSize = CORO_BLOCK_SIZE
+	) {
+		std::vector<double> block(blockSize);
+		std::vector<unsigned char> bytes;
+		BlockDecoder decoder;
+		size_t count;
+
+		initBlockDecoder(&decoder, codec, NULL, 0, false);
+		while (!decoder.finished) {
+			std::span<const unsigned char> chunk = co_await source.read();
+
+			// keep the undecoded tail, then append the new bytes
+			bytes.erase(bytes.begin(), bytes.begin() + decoder.di);
+			bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+			decoder.di = 0;
+			decoder.data = bytes.data();
+			decoder.dataSize = bytes.size();
+			decoder.complete = chunk.empty();
+
+			while ((count = decodeBlock(&decoder, &block[0], blockSize)) > 0) {
+				co_yield std::span<const double>(block.data(), count);
+			}
+		}
+	}
+
+} // namespace MSNumpress
+} // namespace numpress
+} // namespace ms
+
+#endif // C++20 coroutines
+
+#endif // _MSNUMPRESS_CORO_HPP_
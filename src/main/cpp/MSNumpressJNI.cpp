@@ -0,0 +1,134 @@
+/*
+	MSNumpressJNI.cpp
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+/*
+	JNI binding of the C interface for ms.numpress.NativeMSNumpress, working
+	directly on the memory of direct ByteBuffers and DoubleBuffers. Build the
+	library loaded by NativeMSNumpress (on LINUX) with
+
+	> g++ -O2 -shared -fPIC -I$JAVA_HOME/include -I$JAVA_HOME/include/linux \
+		MSNumpress.cpp MSNumpressC.cpp MSNumpressJNI.cpp -o libmsnumpress_jni.so
+
+	Functions return the number of values or bytes written, or minus an
+	msnumpress_status, which NativeMSNumpress turns into an exception. Each
+	thread keeps one msnumpress_context for all its calls.
+ */
+
+#include <jni.h>
+#include "MSNumpressC.h"
+
+/**
+ * Address of element offset in a direct buffer, or NULL if buffer is not
+ * direct or offset + size is out of range. Capacities, offsets and sizes of
+ * direct buffers count elements, of elementSize bytes.
+ */
+static void *directAddress(
+		JNIEnv *env,
+		jobject buffer,
+		jlong offset,
+		jlong size,
+		size_t elementSize
+) {
+	unsigned char *address = static_cast<unsigned char *>(env->GetDirectBufferAddress(buffer));
+	jlong capacity = env->GetDirectBufferCapacity(buffer);
+	if (address == NULL || offset < 0 || size < 0 || offset + size > capacity)
+		return NULL;
+	return address + offset * elementSize;
+}
+
+
+
+/**
+ * The context of the calling thread, created on its first call and freed
+ * when the thread exits, or NULL if out of memory.
+ */
+static msnumpress_context *threadContext() {
+	struct Holder {
+		msnumpress_context *context;
+		Holder() : context(NULL) {}
+		~Holder() { msnumpress_context_free(context); }
+	};
+	static thread_local Holder holder;
+	if (holder.context == NULL) holder.context = msnumpress_context_new();
+	return holder.context;
+}
+
+
+
+extern "C" {
+
+JNIEXPORT jint JNICALL Java_ms_numpress_NativeMSNumpress_decodeNative(
+		JNIEnv *env,
+		jclass,
+		jint codec,
+		jobject data,
+		jint dataOffset,
+		jint dataSize,
+		jobject result,
+		jint resultOffset,
+		jint resultCapacity
+) {
+	const unsigned char *bytes = static_cast<const unsigned char *>(
+			directAddress(env, data, dataOffset, dataSize, 1));
+	double *values = static_cast<double *>(
+			directAddress(env, result, resultOffset, resultCapacity, sizeof(double)));
+	if (bytes == NULL || values == NULL)
+		return -MSNUMPRESS_ERROR_ARGUMENT;
+
+	msnumpress_context *context = threadContext();
+	if (context == NULL)
+		return -MSNUMPRESS_ERROR_MEMORY;
+
+	size_t decoded = 0;
+	msnumpress_status status = msnumpress_decode(context, static_cast<msnumpress_codec>(codec),
+			bytes, dataSize, values, resultCapacity, &decoded);
+	return status == MSNUMPRESS_OK ? static_cast<jint>(decoded) : -status;
+}
+
+
+
+JNIEXPORT jint JNICALL Java_ms_numpress_NativeMSNumpress_encodeNative(
+		JNIEnv *env,
+		jclass,
+		jint codec,
+		jobject data,
+		jint dataOffset,
+		jint dataSize,
+		jdouble fixedPoint,
+		jobject result,
+		jint resultOffset,
+		jint resultCapacity
+) {
+	const double *values = static_cast<const double *>(
+			directAddress(env, data, dataOffset, dataSize, sizeof(double)));
+	unsigned char *bytes = static_cast<unsigned char *>(
+			directAddress(env, result, resultOffset, resultCapacity, 1));
+	if (values == NULL || bytes == NULL)
+		return -MSNUMPRESS_ERROR_ARGUMENT;
+
+	msnumpress_context *context = threadContext();
+	if (context == NULL)
+		return -MSNUMPRESS_ERROR_MEMORY;
+
+	size_t encoded = 0;
+	msnumpress_status status = msnumpress_encode(context, static_cast<msnumpress_codec>(codec),
+			values, dataSize, fixedPoint, bytes, resultCapacity, &encoded);
+	return status == MSNUMPRESS_OK ? static_cast<jint>(encoded) : -status;
+}
+
+} // extern "C"
@@ -20,16 +20,24 @@
 /*
 	Compile and run tests (on LINUX) with
 	
-	> g++ MSNumpress.cpp MSNumpressTest.cpp -o test && ./test
+	> g++ MSNumpress.cpp MSNumpressCache.cpp MSNumpressArena.cpp MSNumpressC.cpp MSNumpressTest.cpp -o test && ./test
 
  */
 
 #include "MSNumpress.hpp"
+#include "MSNumpressCoro.hpp"
+#include "MSNumpressCache.hpp"
+#include "MSNumpressArena.hpp"
+#include "MSNumpressC.h"
 #include <assert.h>
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
+#include <algorithm>
 #include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <string>
 
 using std::cout;
 using std::endl;
@@ -450,6 +458,75 @@ void encodeDecodeLinear5() {
 
 
 
+void encodeDecodeLinearRuns() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double rts[1000];
+	for (size_t i=0; i<n; i++) 
+		rts[i] = 10.0 + i * 0.25;
+	// a gap and some jitter, splitting the grid in three runs
+	for (size_t i=400; i<n; i++) 
+		rts[i] += 3.0;
+	for (size_t i=700; i<710; i++) 
+		rts[i] += rand() / double(RAND_MAX) * 0.01;
+	
+	double fixedPoint = ms::numpress::MSNumpress::optimalLinearRunsFixedPoint(&rts[0], n);
+	
+	unsigned char encoded[5008];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeLinear(&rts[0], n, &encoded[0], fixedPoint);
+	double decoded[1000];
+	ms::numpress::MSNumpress::decodeLinear(&encoded[0], encodedBytes, &decoded[0]);
+	
+	unsigned char runsEncoded[5008];
+	size_t runsEncodedBytes = ms::numpress::MSNumpress::encodeLinearRuns(&rts[0], n, &runsEncoded[0], fixedPoint);
+	assert(runsEncodedBytes < 80);
+	
+	size_t numDecoded = ms::numpress::MSNumpress::decodeLinearRunsLength(&runsEncoded[0], runsEncodedBytes);
+	assert(n == numDecoded);
+	
+	double runsDecoded[1000];
+	numDecoded = ms::numpress::MSNumpress::decodeLinearRuns(&runsEncoded[0], runsEncodedBytes, &runsDecoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(decoded[i] == runsDecoded[i]);
+	
+	// plain linear data decodes the same way
+	numDecoded = ms::numpress::MSNumpress::decodeLinearRuns(&encoded[0], encodedBytes, &runsDecoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(decoded[i] == runsDecoded[i]);
+	
+	// the vector overload, growing its result beyond the bound without runs
+	std::vector<unsigned char> runsVector(&runsEncoded[0], &runsEncoded[runsEncodedBytes]);
+	std::vector<double> decodedVector;
+	ms::numpress::MSNumpress::decodeLinearRuns(runsVector, decodedVector);
+	assert(n == decodedVector.size());
+	for (size_t i=0; i<n; i++) 
+		assert(decoded[i] == decodedVector[i]);
+	
+	// runs of 2^28 - 1 values with a step of 2^32, which overflow a long long
+	unsigned char corrupt[52] = { 0 };
+	std::copy(runsEncoded, runsEncoded + 8, corrupt);
+	corrupt[12] = corrupt[13] = corrupt[14] = corrupt[15] = 0xff;
+	for (size_t i=0; i<36; i+=9) {
+		const unsigned char tokens[9] = { 0x0f, 0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0xf0 };
+		std::copy(tokens, tokens + 9, &corrupt[16 + i]);
+	}
+	try {
+		ms::numpress::MSNumpress::decodeLinearRunsLength(&corrupt[0], 52);
+		cout << "- fail    encodeDecodeLinearRuns: didn't throw exception for corrupt input " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	cout << "+     size compressed: " << runsEncodedBytes / double(n*8) * 100 << "% " << endl;
+	cout << "+ pass    encodeDecodeLinearRuns " << endl << endl;
+}
+
+
+
 void encodeDecodePic() {
 	srand(123459);
 	
@@ -516,6 +593,104 @@ void encodeDecodePic5() {
 
 
 
+void encodeDecodeShuffled() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double mzs[1000];
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=1; i<n; i++) 
+		mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	
+	// planes of the shuffled safe encoding are the bytes of the safe encoding
+	unsigned char encoded[8000];
+	unsigned char shuffled[8000];
+	unsigned char expected[8000];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeSafe(&mzs[0], n, &encoded[0]);
+	size_t shuffledBytes = ms::numpress::MSNumpress::encodeSafeShuffled(&mzs[0], n, &shuffled[0]);
+	assert(encodedBytes == shuffledBytes);
+	for (size_t i=0; i<n; i++) 
+		for (size_t j=0; j<8; j++) 
+			expected[j * n + i] = encoded[i * 8 + j];
+	for (size_t i=0; i<shuffledBytes; i++) 
+		assert(expected[i] == shuffled[i]);
+	
+	ms::numpress::MSNumpress::shuffleBytes(&encoded[0], n, 8, &expected[0]);
+	for (size_t i=0; i<shuffledBytes; i++) 
+		assert(expected[i] == shuffled[i]);
+	ms::numpress::MSNumpress::unshuffleBytes(&shuffled[0], n, 8, &expected[0]);
+	for (size_t i=0; i<encodedBytes; i++) 
+		assert(expected[i] == encoded[i]);
+	
+	double decoded[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodeSafeShuffled(&shuffled[0], shuffledBytes, &decoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(mzs[i] == decoded[i]);
+	
+	// slof
+	double ics[1000];
+	for (size_t i=0; i<n; i++) 
+		ics[i] = rand() % 1000000;
+	double fixedPoint = ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n);
+	encodedBytes = ms::numpress::MSNumpress::encodeSlof(&ics[0], n, &encoded[0], fixedPoint);
+	shuffledBytes = ms::numpress::MSNumpress::encodeSlofShuffled(&ics[0], n, &shuffled[0], fixedPoint);
+	assert(encodedBytes == shuffledBytes);
+	ms::numpress::MSNumpress::unshuffleBytes(&shuffled[8], n, 2, &expected[8]);
+	for (size_t i=8; i<encodedBytes; i++) 
+		assert(expected[i] == encoded[i]);
+	
+	double slofDecoded[1000];
+	ms::numpress::MSNumpress::decodeSlof(&encoded[0], encodedBytes, &slofDecoded[0]);
+	numDecoded = ms::numpress::MSNumpress::decodeSlofShuffled(&shuffled[0], shuffledBytes, &decoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(slofDecoded[i] == decoded[i]);
+	
+	cout << "+ pass    encodeDecodeShuffled " << endl << endl;
+}
+
+
+
+void encodeDecodePicSqrt() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double ics[1000];
+	for (size_t i=0; i<n; i++) 
+		ics[i] = rand() % 1000000;
+	ics[1] = 0.0;
+	ics[2] = 1.0;
+	
+	unsigned char picEncoded[5000];
+	size_t picEncodedBytes = ms::numpress::MSNumpress::encodePic(&ics[0], n, &picEncoded[0]);
+	
+	double fixedPoint = 2.0;
+	unsigned char encoded[5008];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodePicSqrt(&ics[0], n, &encoded[0], fixedPoint);
+	assert(encodedBytes < picEncodedBytes);
+	
+	double decoded[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodePicSqrt(&encoded[0], encodedBytes, &decoded[0]);
+	assert(n == numDecoded);
+	assert(0.0 == decoded[1]);
+	
+	double m = 0;
+	for (size_t i=0; i<n; i++) {
+		// error in standard deviations of the counting noise
+		double error = abs(ics[i] - decoded[i]) / max(sqrt(ics[i]), 1.0);
+		m = max(m, error);
+		assert(error <= 1 / fixedPoint + 1 / (4 * fixedPoint * fixedPoint));
+	}
+	
+	cout << "+     size compressed: " << encodedBytes / double(n*8) * 100 << "% " 
+		 << " (pic: " << picEncodedBytes / double(n*8) * 100 << "%)" << endl;
+	cout << "+    max error in std: " << m << endl;
+	cout << "+ pass    encodeDecodePicSqrt " << endl << endl;
+}
+
+
+
 void optimalSlofFixedPoint() {
 
 	srand(123459);
@@ -582,6 +757,48 @@ void encodeDecodeSlof() {
 
 
 
+void encodeSlofFast() {
+	srand(123459);
+	
+	size_t n = 100000;
+	std::vector<double> ics(n);
+	for (size_t i=0; i<n; i++) 
+		ics[i] = rand() % 10 == 0 ? rand() / double(RAND_MAX) : rand() % 10000000;
+	ics[1] = 0.0;
+	ics[2] = 0.0001;
+	
+	double fixedPoint = ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n);
+	
+	std::vector<unsigned char> encoded, fastEncoded;
+	ms::numpress::MSNumpress::encodeSlof(ics, encoded, fixedPoint);
+	ms::numpress::MSNumpress::encodeSlofFast(ics, fastEncoded, fixedPoint);
+	assert(encoded.size() == fastEncoded.size());
+	
+	size_t mismatches = 0;
+	for (size_t i=8; i<encoded.size(); i+=2) {
+		int x = encoded[i] | (encoded[i+1] << 8);
+		int fx = fastEncoded[i] | (fastEncoded[i+1] << 8);
+		assert(abs(x - fx) <= 1);
+		if (x != fx) mismatches++;
+	}
+	assert(mismatches * 10000 < n);
+	
+	// short arrays, ending in a partly padded group of values
+	for (size_t m=1; m<10; m++) {
+		std::vector<double> few(ics.begin() + 3, ics.begin() + 3 + m);
+		std::vector<unsigned char> fewEncoded;
+		ms::numpress::MSNumpress::encodeSlofFast(few, fewEncoded, fixedPoint);
+		assert(fewEncoded.size() == 8 + 2 * m);
+		for (size_t i=8; i<fewEncoded.size(); i++) 
+			assert(fewEncoded[i] == fastEncoded[i + 6]);
+	}
+	
+	cout << "+          mismatches: " << mismatches << " of " << n << endl;
+	cout << "+ pass    encodeSlofFast " << endl << endl;
+}
+
+
+
 void encodeDecodeSlof5() {
 	srand(123459);
 	
@@ -629,6 +846,1108 @@ void encodeDecodeSlof5() {
 
 
 
+void encodeDecodeStep() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double ims[1000];
+	double im = 1.35;
+	for (size_t i=0; i<n; i++) {
+		if (rand() % 8 == 0) 
+			im -= 0.0011 + (rand() % 10) / 1000000.0;
+		ims[i] = im;
+	}
+	
+	double fixedPoint = ms::numpress::MSNumpress::optimalStepFixedPoint(&ims[0], n);
+	
+	unsigned char encoded[9013];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeStep(&ims[0], n, &encoded[0], fixedPoint);
+	assert(n == ms::numpress::MSNumpress::decodeStepLength(&encoded[0], encodedBytes));
+	
+	double decoded[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodeStep(&encoded[0], encodedBytes, &decoded[0]);
+	assert(n == numDecoded);
+	
+	double m = 0;
+	for (size_t i=0; i<n; i++) {
+		m = max(m, abs(ims[i] - decoded[i]));
+		assert(abs(ims[i] - decoded[i]) < 0.5 / fixedPoint + 1e-12);
+	}
+	
+	unsigned char linEncoded[5008];
+	size_t linEncodedBytes = ms::numpress::MSNumpress::encodeLinear(&ims[0], n, &linEncoded[0], 
+			ms::numpress::MSNumpress::optimalLinearFixedPoint(&ims[0], n));
+	assert(encodedBytes < linEncodedBytes);
+	
+	try {
+		ms::numpress::MSNumpress::decodeStep(&encoded[0], encodedBytes - 1, &decoded[0]);
+		cout << "- fail    encodeDecodeStep: didn't throw exception for corrupt input " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	// empty arrays take only the header
+	assert(ms::numpress::MSNumpress::encodeStep(&ims[0], 0, &encoded[0], fixedPoint) == 12);
+	assert(ms::numpress::MSNumpress::decodeStepLength(&encoded[0], 12) == 0);
+	assert(ms::numpress::MSNumpress::decodeStep(&encoded[0], 12, &decoded[0]) == 0);
+	std::vector<double> empty, emptyDecoded(1);
+	std::vector<unsigned char> emptyEncoded;
+	ms::numpress::MSNumpress::encodeStep(empty, emptyEncoded, fixedPoint);
+	assert(emptyEncoded.size() == 12);
+	ms::numpress::MSNumpress::decodeStep(emptyEncoded, emptyDecoded);
+	assert(emptyDecoded.empty());
+	
+	cout << "+     size compressed: " << encodedBytes / double(n*8) * 100 << "% " 
+		 << " (linear: " << linEncodedBytes / double(n*8) * 100 << "%)" << endl;
+	cout << "+           max error: " << m << endl;
+	cout << "+ pass    encodeDecodeStep " << endl << endl;
+}
+
+
+
+void encodeDecodeCalibrated() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double a = 0.000353;
+	double b = -0.0172;
+	double mzs[1000], bins[1000];
+	size_t t = 40000;
+	for (size_t i=0; i<n; i++) {
+		// profile data, contiguous bins with occasional gaps
+		t += (rand() % 50 == 0) ? 1 + rand() % 300 : 1;
+		mzs[i] = (a * t + b) * (a * t + b);
+		bins[i] = t;
+	}
+	
+	unsigned char encoded[5021];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeCalibrated(&mzs[0], n, &encoded[0], a, b, 1e-9);
+	assert(0 == encoded[0]);
+	assert(n == ms::numpress::MSNumpress::decodeCalibratedLength(&encoded[0], encodedBytes));
+	
+	double decoded[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodeCalibrated(&encoded[0], encodedBytes, &decoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(mzs[i] == decoded[i]);
+	assert(encodedBytes * 2 < n);
+	
+	// the bins as encodeLinearRuns, without its fixed point of 1
+	unsigned char binsEncoded[5008];
+	assert(encodedBytes == 21 - 8 + ms::numpress::MSNumpress::encodeLinearRuns(&bins[0], n, &binsEncoded[0], 1.0));
+	
+	cout << "+     size compressed: " << encodedBytes / double(n*8) * 100 << "% " << endl;
+	
+	// off-calibration values fall back to linear
+	mzs[500] += 0.001;
+	encodedBytes = ms::numpress::MSNumpress::encodeCalibrated(&mzs[0], n, &encoded[0], a, b, 1e-9);
+	assert(1 == encoded[0]);
+	numDecoded = ms::numpress::MSNumpress::decodeCalibrated(&encoded[0], encodedBytes, &decoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(abs(mzs[i] - decoded[i]) < 0.000005);
+	
+	cout << "+ pass    encodeDecodeCalibrated " << endl << endl;
+}
+
+
+
+void encodeDecodeSpectrum() {
+	srand(123459);
+	
+	size_t n = 100;
+	std::vector<double> mzs(n), ics(n), ims(n);
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=1; i<n; i++) 
+		mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	for (size_t i=0; i<n; i++) {
+		ics[i] = rand() % 1000000;
+		ims[i] = 0.6 + i * 0.001;
+	}
+	
+	double mzFixedPoint = ms::numpress::MSNumpress::optimalLinearFixedPoint(&mzs[0], n);
+	double icFixedPoint = ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n);
+	double imFixedPoint = 1000000; // stored exactly as float, like the two above
+	
+	std::vector<unsigned char> encoded;
+	ms::numpress::MSNumpress::encodeSpectrum(mzs, ics, ims, encoded, 
+			mzFixedPoint, ms::numpress::MSNumpress::INTENSITY_SLOF, icFixedPoint, imFixedPoint);
+	
+	std::vector<unsigned char> encodedMzs, encodedIcs, encodedIms;
+	std::vector<double> decodedMzs, decodedIcs, decodedIms;
+	ms::numpress::MSNumpress::encodeLinear(mzs, encodedMzs, mzFixedPoint);
+	ms::numpress::MSNumpress::encodeSlof(ics, encodedIcs, icFixedPoint);
+	ms::numpress::MSNumpress::encodeLinear(ims, encodedIms, imFixedPoint);
+	ms::numpress::MSNumpress::decodeLinear(encodedMzs, decodedMzs);
+	ms::numpress::MSNumpress::decodeSlof(encodedIcs, decodedIcs);
+	
+	// the sections are the separate arrays without their 8 byte fixed points, 
+	// behind a 2 byte peak count and the 4 byte fixed points
+	size_t separateBytes = encodedMzs.size() + encodedIcs.size() + encodedIms.size();
+	assert(encoded.size() == separateBytes - 3 * 8 + 2 + 3 * 4);
+	assert(encoded.size() < separateBytes);
+	
+	std::vector<double> mzsOut, icsOut, imsOut;
+	ms::numpress::MSNumpress::decodeSpectrum(encoded, mzsOut, icsOut, imsOut);
+	assert(n == mzsOut.size() && n == icsOut.size() && n == imsOut.size());
+	for (size_t i=0; i<n; i++) {
+		assert(decodedMzs[i] == mzsOut[i]);
+		assert(decodedIcs[i] == icsOut[i]);
+		assert(abs(ims[i] - imsOut[i]) < 0.000005);
+	}
+	
+	// without ion mobility, with Pic
+	std::vector<double> noIms;
+	std::vector<unsigned char> encodedPic;
+	ms::numpress::MSNumpress::encodePic(ics, encodedPic);
+	ms::numpress::MSNumpress::encodeSpectrum(mzs, ics, noIms, encoded, 
+			mzFixedPoint, ms::numpress::MSNumpress::INTENSITY_PIC, 0, 0);
+	assert(encoded.size() == encodedMzs.size() + encodedPic.size() - 8 + 2 + 4);
+	ms::numpress::MSNumpress::decodeSpectrum(encoded, mzsOut, icsOut, imsOut);
+	assert(n == mzsOut.size() && n == icsOut.size() && imsOut.empty());
+	for (size_t i=0; i<n; i++) 
+		assert(ics[i] == icsOut[i]);
+	
+	// with ion mobility and Pic, where the Pic section ends after n values
+	std::vector<unsigned char> encodedPicIms;
+	ms::numpress::MSNumpress::encodeSpectrum(mzs, ics, ims, encodedPicIms, 
+			mzFixedPoint, ms::numpress::MSNumpress::INTENSITY_PIC, 0, imFixedPoint);
+	assert(encodedPicIms.size() == encoded.size() + encodedIms.size() - 8 + 4);
+	ms::numpress::MSNumpress::decodeSpectrum(encodedPicIms, mzsOut, icsOut, imsOut);
+	assert(n == mzsOut.size() && n == icsOut.size() && n == imsOut.size());
+	for (size_t i=0; i<n; i++) {
+		assert(decodedMzs[i] == mzsOut[i]);
+		assert(ics[i] == icsOut[i]);
+		assert(abs(ims[i] - imsOut[i]) < 0.000005);
+	}
+	
+	// a header claiming fewer peaks than the sections hold
+	ms::numpress::MSNumpress::encodeSpectrum(mzs, ics, ims, encoded, 
+			mzFixedPoint, ms::numpress::MSNumpress::INTENSITY_SLOF, icFixedPoint, imFixedPoint);
+	encoded[0] = static_cast<unsigned char>(encoded[0] - 4);
+	try {
+		ms::numpress::MSNumpress::decodeSpectrum(encoded, mzsOut, icsOut, imsOut);
+		cout << "- fail    encodeDecodeSpectrum: didn't throw exception for corrupt input " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	cout << "+ pass    encodeDecodeSpectrum " << endl << endl;
+}
+
+
+
+double halfToDouble(unsigned short h) {
+	int e = (h >> 10) & 0x1f;
+	double m = h & 0x3ff;
+	double sign = (h & 0x8000) ? -1 : 1;
+	if (e == 0x1f) return m == 0 ? sign * HUGE_VAL : NAN;
+	if (e == 0) return sign * ldexp(m, -24);
+	return sign * ldexp(m + 1024, e - 25);
+}
+
+
+
+void decodeSlofLogHalf() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double ics[1000];
+	for (size_t i=0; i<n; i++) 
+		ics[i] = rand() % 100000;
+	ics[1] = 0.0;
+	ics[2] = 0.0001;
+	
+	double fixedPoint = ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n);
+	
+	unsigned char encoded[2008];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeSlof(&ics[0], n, &encoded[0], fixedPoint);
+	double decoded[1000];
+	ms::numpress::MSNumpress::decodeSlof(&encoded[0], encodedBytes, &decoded[0]);
+	
+	double logs[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodeSlofLog(&encoded[0], encodedBytes, &logs[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(exp(logs[i]) - 1 == decoded[i]);
+	
+	unsigned short halfs[1000];
+	int exponent;
+	numDecoded = ms::numpress::MSNumpress::decodeSlofHalf(&encoded[0], encodedBytes, &halfs[0], &exponent);
+	assert(n == numDecoded);
+	assert(ldexp(65504.0, exponent) >= exp(65535 / fixedPoint) - 1);
+	assert(ldexp(65504.0, exponent - 1) < exp(65535 / fixedPoint) - 1);
+	for (size_t i=0; i<n; i++) {
+		double h = ldexp(halfToDouble(halfs[i]), exponent);
+		assert(abs(h - decoded[i]) <= max(decoded[i] / 2048, ldexp(1.0, exponent - 25)));
+	}
+	
+	// the largest value the fixed point can store stays finite
+	encoded[8] = encoded[9] = 0xff;
+	ms::numpress::MSNumpress::decodeSlofHalf(&encoded[0], 10, &halfs[0], &exponent);
+	assert(halfs[0] <= 0x7bff);
+	assert(halfToDouble(halfs[0]) > 65504 / 2);
+	
+	// small fixed points scale up
+	double small[3] = { 0.0, 0.001, 0.5 };
+	encodedBytes = ms::numpress::MSNumpress::encodeSlof(&small[0], 3, &encoded[0], 90000);
+	numDecoded = ms::numpress::MSNumpress::decodeSlofHalf(&encoded[0], encodedBytes, &halfs[0], &exponent);
+	assert(3 == numDecoded);
+	assert(exponent < 0);
+	ms::numpress::MSNumpress::decodeSlof(&encoded[0], encodedBytes, &decoded[0]);
+	for (size_t i=0; i<3; i++) 
+		assert(abs(ldexp(halfToDouble(halfs[i]), exponent) - decoded[i]) <= decoded[i] / 2048);
+	
+	encodedBytes = ms::numpress::MSNumpress::encodeSlof(&small[0], 3, &encoded[0], 90);
+	try {
+		ms::numpress::MSNumpress::decodeSlofHalf(&encoded[0], encodedBytes, &halfs[0], &exponent);
+		cout << "- fail    decodeSlofLogHalf: didn't throw exception for too small fixed point" << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	cout << "+ pass    decodeSlofLogHalf " << endl << endl;
+}
+
+
+
+void encodeDecodeSlofLinear() {
+	srand(123459);
+	
+	size_t n = 1000;
+	double ics[1000];
+	for (size_t i=0; i<n; i++) 
+		ics[i] = 0;
+	// gaussian profile peaks on a zero baseline
+	for (size_t p=0; p<20; p++) {
+		double center = rand() % n;
+		double height = 100 + rand() % 1000000;
+		for (size_t i=0; i<n; i++) 
+			ics[i] += height * exp(-(i - center) * (i - center) / 18.0);
+	}
+	
+	double fixedPoint = ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n);
+	
+	unsigned char slofEncoded[2008];
+	size_t slofEncodedBytes = ms::numpress::MSNumpress::encodeSlof(&ics[0], n, &slofEncoded[0], fixedPoint);
+	double slofDecoded[1000];
+	ms::numpress::MSNumpress::decodeSlof(&slofEncoded[0], slofEncodedBytes, &slofDecoded[0]);
+	
+	unsigned char encoded[5009];
+	size_t encodedBytes = ms::numpress::MSNumpress::encodeSlofLinear(&ics[0], n, &encoded[0], fixedPoint);
+	assert(encodedBytes < slofEncodedBytes);
+	
+	double decoded[1000];
+	size_t numDecoded = ms::numpress::MSNumpress::decodeSlofLinear(&encoded[0], encodedBytes, &decoded[0]);
+	assert(n == numDecoded);
+	for (size_t i=0; i<n; i++) 
+		assert(slofDecoded[i] == decoded[i]);
+	
+	// 65535 followed by a residual of INT_MAX, which overflows an int sum
+	unsigned char corrupt[15] = { 0, 0, 0, 0, 0, 0, 0, 0, 0x4f, 0xff, 0xf0, 0xff, 0xff, 0xff, 0xf7 };
+	std::copy(encoded, encoded + 8, corrupt);
+	try {
+		ms::numpress::MSNumpress::decodeSlofLinear(&corrupt[0], 15, &decoded[0]);
+		cout << "- fail    encodeDecodeSlofLinear: didn't throw exception for corrupt input " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	cout << "+     size compressed: " << encodedBytes / double(n*8) * 100 << "% " 
+		 << " (slof: " << slofEncodedBytes / double(n*8) * 100 << "%)" << endl;
+	cout << "+ pass    encodeDecodeSlofLinear " << endl << endl;
+}
+
+
+
+void decodeBlocks() {
+	srand(123459);
+	
+	size_t n = 10000;
+	std::vector<double> ics(n), mzs(n);
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=0; i<n; i++) {
+		ics[i] = rand() % 100000;
+		if (i > 0) mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	}
+	
+	std::vector<unsigned char> encoded[3];
+	ms::numpress::MSNumpress::encodeLinear(mzs, encoded[0], 
+			ms::numpress::MSNumpress::optimalLinearFixedPoint(&mzs[0], n));
+	ms::numpress::MSNumpress::encodePic(ics, encoded[1]);
+	ms::numpress::MSNumpress::encodeSlof(ics, encoded[2], 
+			ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n));
+	
+	ms::numpress::MSNumpress::BlockCodec codecs[3] = { 
+		ms::numpress::MSNumpress::BLOCK_LINEAR,
+		ms::numpress::MSNumpress::BLOCK_PIC,
+		ms::numpress::MSNumpress::BLOCK_SLOF
+	};
+	
+	for (int c=0; c<3; c++) {
+		std::vector<double> expected;
+		if (c == 0) ms::numpress::MSNumpress::decodeLinear(encoded[c], expected);
+		if (c == 1) ms::numpress::MSNumpress::decodePic(encoded[c], expected);
+		if (c == 2) ms::numpress::MSNumpress::decodeSlof(encoded[c], expected);
+		
+		// whole buffer at once, blocks of 7
+		ms::numpress::MSNumpress::BlockDecoder decoder;
+		double block[7];
+		size_t count = 0, got;
+		ms::numpress::MSNumpress::initBlockDecoder(
+				&decoder, codecs[c], &encoded[c][0], encoded[c].size(), true);
+		while ((got = ms::numpress::MSNumpress::decodeBlock(&decoder, block, 7)) > 0) {
+			for (size_t i=0; i<got; i++) 
+				assert(block[i] == expected[count + i]);
+			count += got;
+		}
+		assert(decoder.finished);
+		assert(count == n);
+		
+		// bytes arriving in chunks of 3
+		size_t available = 0;
+		count = 0;
+		ms::numpress::MSNumpress::initBlockDecoder(
+				&decoder, codecs[c], &encoded[c][0], 0, false);
+		while (!decoder.finished) {
+			while ((got = ms::numpress::MSNumpress::decodeBlock(&decoder, block, 7)) > 0) {
+				for (size_t i=0; i<got; i++) 
+					assert(block[i] == expected[count + i]);
+				count += got;
+			}
+			available = std::min(available + 3, encoded[c].size());
+			decoder.dataSize = available;
+			decoder.complete = available == encoded[c].size();
+		}
+		assert(count == n);
+	}
+	
+	cout << "+ pass    decodeBlocks " << endl << endl;
+}
+
+
+
+/**
+ * Visitor summing the values of blocks, stopping after limit values.
+ */
+struct SumVisitor {
+	double *sum;
+	size_t *count;
+	size_t limit;
+	
+	bool operator()(const double *values, size_t n) {
+		for (size_t i=0; i<n; i++) *sum += values[i];
+		*count += n;
+		return *count < limit;
+	}
+};
+
+
+
+void decodeVisitBlocks() {
+	srand(123459);
+	
+	size_t n = 10000;
+	std::vector<double> ics(n), decoded;
+	for (size_t i=0; i<n; i++) 
+		ics[i] = rand() % 100000;
+	
+	std::vector<unsigned char> encoded;
+	ms::numpress::MSNumpress::encodeSlof(ics, encoded, 
+			ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n));
+	ms::numpress::MSNumpress::decodeSlof(encoded, decoded);
+	
+	double sum = 0, expectedSum = 0;
+	size_t count = 0;
+	for (size_t i=0; i<n; i++) expectedSum += decoded[i];
+	
+	SumVisitor visitor = { &sum, &count, n };
+	assert(ms::numpress::MSNumpress::decodeSlofBlocks(encoded, visitor) == n);
+	assert(count == n);
+	assert(sum == expectedSum);
+	
+	// stops after the block reaching the limit
+	sum = 0;
+	count = 0;
+	visitor.limit = 1000;
+	size_t visited = ms::numpress::MSNumpress::decodeSlofBlocks(&encoded[0], encoded.size(), visitor);
+	assert(visited == 4 * ms::numpress::MSNumpress::VISIT_BLOCK_SIZE);
+	assert(count == visited);
+	
+	ms::numpress::MSNumpress::encodePic(ics, encoded);
+	sum = 0;
+	count = 0;
+	visitor.limit = n;
+	assert(ms::numpress::MSNumpress::decodePicBlocks(encoded, visitor) == n);
+	for (size_t i=0; i<n; i++) sum -= ics[i];
+	assert(sum == 0);
+	
+	cout << "+ pass    decodeVisitBlocks " << endl << endl;
+}
+
+
+
+void lazyDecodedArray() {
+	srand(123459);
+	
+	size_t n = 10000;
+	std::vector<double> ics(n), mzs(n);
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=0; i<n; i++) {
+		ics[i] = rand() % 100000;
+		if (i > 0) mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	}
+	
+	std::vector<unsigned char> encoded[3];
+	std::vector<double> expected[3];
+	ms::numpress::MSNumpress::encodeLinear(mzs, encoded[0], 
+			ms::numpress::MSNumpress::optimalLinearFixedPoint(&mzs[0], n));
+	ms::numpress::MSNumpress::encodePic(ics, encoded[1]);
+	ms::numpress::MSNumpress::encodeSlof(ics, encoded[2], 
+			ms::numpress::MSNumpress::optimalSlofFixedPoint(&ics[0], n));
+	ms::numpress::MSNumpress::decodeLinear(encoded[0], expected[0]);
+	ms::numpress::MSNumpress::decodePic(encoded[1], expected[1]);
+	ms::numpress::MSNumpress::decodeSlof(encoded[2], expected[2]);
+	
+	ms::numpress::MSNumpress::BlockCodec codecs[3] = { 
+		ms::numpress::MSNumpress::BLOCK_LINEAR,
+		ms::numpress::MSNumpress::BLOCK_PIC,
+		ms::numpress::MSNumpress::BLOCK_SLOF
+	};
+	
+	// room for 8 blocks
+	ms::numpress::MSNumpress::DecodedCache cache(
+			8 * ms::numpress::MSNumpress::LAZY_BLOCK_SIZE * sizeof(double), 1);
+	
+	for (int c=0; c<3; c++) {
+		ms::numpress::MSNumpress::LazyDecodedArray array(codecs[c], encoded[c], cache);
+		assert(encoded[c].empty());
+		
+		// random access, jumping ahead of the checkpoints first
+		for (size_t k=0; k<1000; k++) {
+			size_t i = k == 0 ? n - 1 : rand() % n;
+			assert(array[i] == expected[c][i]);
+		}
+		assert(cache.bytes() <= cache.maxBytes());
+		assert(array.size() == n);
+		
+		std::vector<double> range(n);
+		array.copy(0, n, &range[0]);
+		assert(range == expected[c]);
+		array.copy(300, 1000, &range[0]);
+		assert(range[0] == expected[c][300] && range[699] == expected[c][999]);
+		
+		try {
+			array.at(n);
+			cout << "- fail    lazyDecodedArray: didn't throw exception for index out of range " << endl << endl;
+			assert(0 == 1);
+		} catch (const char *err) {
+			
+		}
+	}
+	
+	cache.setMaxBytes(0);
+	assert(cache.bytes() == 0);
+	
+	cout << "+ pass    lazyDecodedArray " << endl << endl;
+}
+
+
+
+void decodeCached() {
+	srand(123459);
+	
+	size_t n = 1000, arrays = 64;
+	std::vector<std::vector<unsigned char> > encoded(arrays);
+	std::vector<std::vector<double> > expected(arrays);
+	for (size_t a=0; a<arrays; a++) {
+		std::vector<double> ics(n);
+		for (size_t i=0; i<n; i++) ics[i] = rand() % 100000;
+		ms::numpress::MSNumpress::encodePic(ics, encoded[a]);
+		ms::numpress::MSNumpress::decodePic(encoded[a], expected[a]);
+	}
+	
+	// room for 16 arrays
+	ms::numpress::MSNumpress::DecodedCache cache(16 * n * sizeof(double), 4);
+	std::vector<double> decoded;
+	ms::numpress::MSNumpress::decodeCached(
+			ms::numpress::MSNumpress::BLOCK_PIC, encoded[0], decoded, cache);
+	assert(decoded == expected[0]);
+	ms::numpress::MSNumpress::decodeCached(
+			ms::numpress::MSNumpress::BLOCK_PIC, encoded[0], decoded, cache);
+	assert(decoded == expected[0]);
+	ms::numpress::MSNumpress::CacheStats stats = cache.stats();
+	assert(stats.hits == 1 && stats.misses == 1 && stats.entries == 1);
+	
+	// the same bytes decoded as another codec are another entry
+	ms::numpress::MSNumpress::decodeCached(
+			ms::numpress::MSNumpress::BLOCK_LINEAR, encoded[0], decoded, cache);
+	assert(cache.stats().entries == 2);
+	
+	// keyed by container, in a batch
+	unsigned long long file = ms::numpress::MSNumpress::newCacheId();
+	std::vector<const unsigned char *> data(arrays);
+	std::vector<size_t> sizes(arrays);
+	std::vector<ms::numpress::MSNumpress::CacheKey> keys(arrays);
+	std::vector<ms::numpress::MSNumpress::DecodedBlock> results(arrays);
+	for (size_t a=0; a<arrays; a++) {
+		data[a] = &encoded[a][0];
+		sizes[a] = encoded[a].size();
+		keys[a].id = file;
+		keys[a].index = a;
+	}
+	cache.clear();
+	cache.resetStats();
+	for (int pass=0; pass<2; pass++) {
+		ms::numpress::MSNumpress::decodeBatchCached(ms::numpress::MSNumpress::BLOCK_PIC,
+				&data[0], &sizes[0], arrays, &keys[0], &results[0], cache);
+		for (size_t a=0; a<arrays; a++) 
+			assert(*results[a] == expected[a]);
+	}
+	stats = cache.stats();
+	assert(stats.hits + stats.misses == 2 * arrays);
+	assert(stats.evictions > 0);
+	assert(stats.bytes <= cache.maxBytes());
+	
+	// a working set within the budget stays cached, however its keys fall 
+	// into shards
+	ms::numpress::MSNumpress::DecodedCache sharded(16 * n * sizeof(double));
+	for (size_t k=0; k<8000; k++) {
+		size_t a = k % 12;
+		assert(*ms::numpress::MSNumpress::decodeCached(ms::numpress::MSNumpress::BLOCK_PIC, 
+				data[a], sizes[a], keys[a], sharded) == expected[a]);
+	}
+	assert(sharded.stats().misses == 12);
+	assert(sharded.stats().evictions == 0);
+	
+	// concurrent lookups of a popular set
+	cache.resetStats();
+	std::vector<std::thread> threads;
+	std::atomic<int> wrong(0);
+	for (int t=0; t<4; t++) {
+		threads.push_back(std::thread([&, t]() {
+			for (size_t k=0; k<2000; k++) {
+				size_t a = (k * 7 + t) % 12;
+				if (*ms::numpress::MSNumpress::decodeCached(ms::numpress::MSNumpress::BLOCK_PIC, 
+						data[a], sizes[a], keys[a], cache) != expected[a]) 
+					wrong++;
+			}
+		}));
+	}
+	for (size_t t=0; t<threads.size(); t++) threads[t].join();
+	assert(wrong == 0);
+	assert(cache.bytes() <= cache.maxBytes());
+	
+	// each thread misses each array of the set at most once
+	stats = cache.stats();
+	double hitRatio = stats.hits / double(stats.hits + stats.misses);
+	assert(stats.hits + stats.misses == 4 * 2000);
+	assert(stats.misses <= 4 * 12);
+	assert(hitRatio > 0.99);
+	
+	cout << "+           hit ratio: " << hitRatio << endl;
+	cout << "+ pass    decodeCached " << endl << endl;
+}
+
+
+
+void cvAccessionRegistry() {
+	srand(123459);
+	
+	assert(ms::numpress::MSNumpress::resolveCvAccession("MS:1002312") == ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR);
+	assert(ms::numpress::MSNumpress::resolveCvAccession("MS:1002747") == ms::numpress::MSNumpress::CV_NUMPRESS_PIC_ZLIB);
+	assert(ms::numpress::MSNumpress::resolveCvAccession("MS:1000574") == ms::numpress::MSNumpress::CV_UNKNOWN);
+	assert(ms::numpress::MSNumpress::resolveCvAccession(NULL) == ms::numpress::MSNumpress::CV_UNKNOWN);
+	
+	for (int c=ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR; c<=ms::numpress::MSNumpress::CV_NUMPRESS_SLOF_ZLIB; c++) {
+		const ms::numpress::MSNumpress::CodecDescriptor &d = 
+				ms::numpress::MSNumpress::codecDescriptor(static_cast<ms::numpress::MSNumpress::CvCodec>(c));
+		assert(d.cvCodec == c);
+		assert(ms::numpress::MSNumpress::resolveCvAccession(d.accession) == c);
+		assert(d.zlib == (c >= ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR_ZLIB));
+	}
+	
+	size_t n = 1000, arrays = 3;
+	std::vector<double> ics(n);
+	for (size_t i=0; i<n; i++) ics[i] = rand() % 100000;
+	
+	// encode and decode through the descriptors
+	std::vector<std::vector<unsigned char> > encoded(arrays);
+	std::vector<std::vector<double> > expected(arrays);
+	ms::numpress::MSNumpress::CvCodec codecs[3] = {
+		ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR,
+		ms::numpress::MSNumpress::CV_NUMPRESS_PIC,
+		ms::numpress::MSNumpress::CV_NUMPRESS_SLOF
+	};
+	const unsigned char *data[3];
+	size_t sizes[3], offsets[4], bound = 0;
+	for (size_t a=0; a<arrays; a++) {
+		const ms::numpress::MSNumpress::CodecDescriptor &d = ms::numpress::MSNumpress::codecDescriptor(codecs[a]);
+		encoded[a].resize(d.encodeBound(n));
+		encoded[a].resize(d.encode(&ics[0], n, &encoded[a][0], d.optimalFixedPoint(&ics[0], n)));
+		ms::numpress::MSNumpress::decode(codecs[a], encoded[a], expected[a]);
+		assert(expected[a].size() == n);
+		for (size_t i=0; i<n; i++) 
+			assert(abs(expected[a][i] - ics[i]) <= ics[i] * 0.001 + 0.5);
+		data[a] = &encoded[a][0];
+		sizes[a] = encoded[a].size();
+		bound += d.decodeBound(sizes[a]);
+	}
+	
+	std::vector<double> batch(bound);
+	assert(ms::numpress::MSNumpress::decodeBatch(codecs, data, sizes, arrays, &batch[0], offsets) == 3 * n);
+	for (size_t a=0; a<arrays; a++) 
+		assert(std::equal(expected[a].begin(), expected[a].end(), batch.begin() + offsets[a]));
+	
+	assert(ms::numpress::MSNumpress::decodeBatch(ms::numpress::MSNumpress::CV_NUMPRESS_PIC, 
+			&data[1], &sizes[1], 1, &batch[0], offsets) == n);
+	
+	try {
+		ms::numpress::MSNumpress::decode(ms::numpress::MSNumpress::CV_UNKNOWN, encoded[0], expected[0]);
+		cout << "- fail    cvAccessionRegistry: didn't throw exception for unknown codec " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	cout << "+ pass    cvAccessionRegistry " << endl << endl;
+}
+
+
+
+void cInterface() {
+	srand(123459);
+	
+	size_t n = 1000;
+	std::vector<double> mzs(n);
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=1; i<n; i++) 
+		mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	
+	msnumpress_context *context = msnumpress_context_new();
+	assert(context != NULL);
+	
+	std::vector<unsigned char> encoded(msnumpress_encode_bound(MSNUMPRESS_LINEAR, n));
+	size_t encodedSize, decodedSize;
+	double fixedPoint = msnumpress_optimal_fixed_point(MSNUMPRESS_LINEAR, &mzs[0], n);
+	assert(MSNUMPRESS_OK == msnumpress_encode(context, MSNUMPRESS_LINEAR, &mzs[0], n, 
+			fixedPoint, &encoded[0], encoded.size(), &encodedSize));
+	encoded.resize(encodedSize);
+	
+	std::vector<double> expected, decoded(msnumpress_decode_bound(MSNUMPRESS_LINEAR, encodedSize));
+	ms::numpress::MSNumpress::decodeLinear(encoded, expected);
+	assert(MSNUMPRESS_OK == msnumpress_decode(context, MSNUMPRESS_LINEAR, &encoded[0], encodedSize, 
+			&decoded[0], decoded.size(), &decodedSize));
+	assert(decodedSize == n);
+	assert(std::equal(expected.begin(), expected.end(), decoded.begin()));
+	assert(std::string(msnumpress_last_error(context)) == "");
+	
+	// exact and too small capacities
+	assert(MSNUMPRESS_OK == msnumpress_decode(context, MSNUMPRESS_LINEAR, &encoded[0], encodedSize, 
+			&decoded[0], n, &decodedSize));
+	assert(decodedSize == n);
+	assert(MSNUMPRESS_ERROR_BUFFER == msnumpress_decode(context, MSNUMPRESS_LINEAR, &encoded[0], 
+			encodedSize, &decoded[0], n - 1, &decodedSize));
+	assert(std::string(msnumpress_last_error(context)) != "");
+	
+	// errors are returned, not thrown
+	assert(MSNUMPRESS_ERROR_DATA == msnumpress_decode(context, MSNUMPRESS_LINEAR, &encoded[0], 
+			11, &decoded[0], decoded.size(), &decodedSize));
+	assert(MSNUMPRESS_ERROR_ARGUMENT == msnumpress_decode(context, static_cast<msnumpress_codec>(7), 
+			&encoded[0], encodedSize, &decoded[0], decoded.size(), &decodedSize));
+	
+	// batch of the same array three times
+	const unsigned char *data[3] = { &encoded[0], &encoded[0], &encoded[0] };
+	size_t sizes[3] = { encodedSize, encodedSize, encodedSize };
+	size_t offsets[4];
+	std::vector<double> batch(3 * n);
+	assert(MSNUMPRESS_OK == msnumpress_decode_batch(context, MSNUMPRESS_LINEAR, 
+			data, sizes, 3, &batch[0], batch.size(), offsets));
+	assert(offsets[0] == 0 && offsets[1] == n && offsets[3] == 3 * n);
+	assert(std::equal(expected.begin(), expected.end(), batch.begin() + 2 * n));
+	assert(MSNUMPRESS_ERROR_BUFFER == msnumpress_decode_batch(context, MSNUMPRESS_LINEAR, 
+			data, sizes, 3, &batch[0], batch.size() - 1, offsets));
+	assert(offsets[2] == 2 * n);
+	
+	msnumpress_codec codec;
+	int zlib;
+	assert(MSNUMPRESS_OK == msnumpress_codec_from_accession("MS:1002748", &codec, &zlib));
+	assert(codec == MSNUMPRESS_SLOF && zlib == 1);
+	assert(MSNUMPRESS_ERROR_ARGUMENT == msnumpress_codec_from_accession("MS:1000576", &codec, &zlib));
+	
+	msnumpress_context_free(context);
+	
+	cout << "+ pass    cInterface " << endl << endl;
+}
+
+
+
+void encodeRealtime() {
+	srand(123459);
+	
+	size_t n = 1000;
+	size_t clamped, encodedBytes, decodedDoubles;
+	std::vector<double> mzs(n), ics(n), decoded(2 * n + 2);
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=1; i<n; i++) 
+		mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	for (size_t i=0; i<n; i++) 
+		ics[i] = i % 3 == 0 ? 0 : pow(10, 6.0 * rand() / RAND_MAX);
+	
+	ms::numpress::MSNumpress::RealtimeEncoder encoder;
+	std::vector<unsigned char> encoded(ms::numpress::MSNumpress::realtimeEncodeBound(ms::numpress::MSNumpress::BLOCK_LINEAR, n));
+	std::vector<unsigned char> expected(encoded.size());
+	
+	// Linear, with m/z bounds of the instrument
+	ms::numpress::MSNumpress::initRealtimeEncoder(&encoder, ms::numpress::MSNumpress::BLOCK_LINEAR, 2000, 10);
+	assert(encoder.fixedPoint == ms::numpress::MSNumpress::linearFixedPointForBounds(2000, 10));
+	encodedBytes = ms::numpress::MSNumpress::encodeRealtime(&encoder, &mzs[0], n, &encoded[0], encoded.size(), &clamped);
+	assert(clamped == 0);
+	assert(encodedBytes == ms::numpress::MSNumpress::encodeLinear(&mzs[0], n, &expected[0], encoder.fixedPoint));
+	assert(std::equal(encoded.begin(), encoded.begin() + encodedBytes, expected.begin()));
+	decodedDoubles = ms::numpress::MSNumpress::decodeLinear(&encoded[0], encodedBytes, &decoded[0]);
+	assert(decodedDoubles == n);
+	for (size_t i=0; i<n; i++) 
+		assert(abs(mzs[i] - decoded[i]) <= 0.5 / encoder.fixedPoint + 1e-9);
+	
+	// too small a buffer writes nothing
+	assert(0 == ms::numpress::MSNumpress::encodeRealtime(&encoder, &mzs[0], n, &encoded[0], encoded.size() - 1, &clamped));
+	
+	// values out of bounds are saturated
+	std::vector<double> wild(mzs);
+	wild[10] = 5000;
+	wild[20] = -1;
+	wild[30] = NAN;
+	ms::numpress::MSNumpress::initRealtimeEncoder(&encoder, ms::numpress::MSNumpress::BLOCK_LINEAR, 2000, 2000);
+	encodedBytes = ms::numpress::MSNumpress::encodeRealtime(&encoder, &wild[0], n, &encoded[0], encoded.size(), &clamped);
+	assert(clamped == 3);
+	decodedDoubles = ms::numpress::MSNumpress::decodeLinear(&encoded[0], encodedBytes, &decoded[0]);
+	assert(decodedDoubles == n);
+	assert(abs(decoded[10] - 2000) < 1e-5);
+	assert(abs(decoded[20]) < 1e-5 && abs(decoded[30]) < 1e-5);
+	for (size_t i=31; i<n; i++) 
+		assert(abs(mzs[i] - decoded[i]) <= 0.5 / encoder.fixedPoint + 1e-9);
+	
+	// so are residuals beyond maxStep, and the prediction stays in sync
+	ms::numpress::MSNumpress::initRealtimeEncoder(&encoder, ms::numpress::MSNumpress::BLOCK_LINEAR, 2000, 10);
+	encodedBytes = ms::numpress::MSNumpress::encodeRealtime(&encoder, &wild[0], n, &encoded[0], encoded.size(), &clamped);
+	assert(clamped > 3);
+	decodedDoubles = ms::numpress::MSNumpress::decodeLinear(&encoded[0], encodedBytes, &decoded[0]);
+	assert(decodedDoubles == n);
+	for (size_t i=n/2; i<n; i++) 
+		assert(abs(mzs[i] - decoded[i]) <= 0.5 / encoder.fixedPoint + 1e-9);
+	
+	// Pic matches encodePic
+	ms::numpress::MSNumpress::initRealtimeEncoder(&encoder, ms::numpress::MSNumpress::BLOCK_PIC, 1e7, 0);
+	encodedBytes = ms::numpress::MSNumpress::encodeRealtime(&encoder, &ics[0], n, &encoded[0], encoded.size(), &clamped);
+	assert(clamped == 0);
+	assert(encodedBytes == ms::numpress::MSNumpress::encodePic(&ics[0], n, &expected[0]));
+	assert(std::equal(encoded.begin(), encoded.begin() + encodedBytes, expected.begin()));
+	
+	// Slof matches encodeSlofFast, with the fixed point of the bounds
+	ms::numpress::MSNumpress::initRealtimeEncoder(&encoder, ms::numpress::MSNumpress::BLOCK_SLOF, 1e6, 0);
+	assert(encoder.fixedPoint == ms::numpress::MSNumpress::optimalSlofFixedPoint(&std::vector<double>(1, 1e6)[0], 1));
+	encodedBytes = ms::numpress::MSNumpress::encodeRealtime(&encoder, &ics[0], n, &encoded[0], encoded.size(), &clamped);
+	assert(clamped == 0);
+	assert(encodedBytes == ms::numpress::MSNumpress::encodeSlofFast(&ics[0], n, &expected[0], encoder.fixedPoint));
+	assert(std::equal(encoded.begin(), encoded.begin() + encodedBytes, expected.begin()));
+	
+	cout << "+ pass    encodeRealtime " << endl << endl;
+}
+
+
+
+void decodeStreaming() {
+	srand(123459);
+	
+	// sizes below and above the block of the streaming decoder
+	size_t sizes[3] = { 20000, 300, 40000 };
+	ms::numpress::MSNumpress::CvCodec codecs[3] = {
+		ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR,
+		ms::numpress::MSNumpress::CV_NUMPRESS_PIC,
+		ms::numpress::MSNumpress::CV_NUMPRESS_SLOF
+	};
+	
+	for (size_t a=0; a<3; a++) {
+		const ms::numpress::MSNumpress::CodecDescriptor &d = ms::numpress::MSNumpress::codecDescriptor(codecs[a]);
+		size_t n = sizes[a];
+		std::vector<double> values(n);
+		values[0] = 300 + rand() / double(RAND_MAX);
+		for (size_t i=1; i<n; i++) 
+			values[i] = a == 0 ? values[i-1] + rand() / double(RAND_MAX) : rand() % 100000;
+		
+		std::vector<unsigned char> encoded(d.encodeBound(n));
+		encoded.resize(d.encode(&values[0], n, &encoded[0], d.optimalFixedPoint(&values[0], n)));
+		std::vector<double> expected;
+		ms::numpress::MSNumpress::decode(codecs[a], encoded, expected);
+		
+		// the same array three times, from an odd offset to test unaligned stores
+		const unsigned char *data[3] = { &encoded[0], &encoded[0], &encoded[0] };
+		size_t dataSizes[3] = { encoded.size(), encoded.size(), encoded.size() };
+		size_t offsets[4];
+		std::vector<double> batch(1 + 3 * d.decodeBound(encoded.size()));
+		assert(ms::numpress::MSNumpress::decodeBatch(codecs[a], data, dataSizes, 3, 
+				&batch[1], offsets, 1) == 3 * n);
+		for (size_t k=0; k<3; k++) 
+			assert(std::equal(expected.begin(), expected.end(), batch.begin() + 1 + offsets[k]));
+		
+		std::vector<double> decoded(d.decodeBound(encoded.size()));
+		assert(ms::numpress::MSNumpress::decode(codecs[a], &encoded[0], encoded.size(), &decoded[0], 1) == n);
+		assert(std::equal(expected.begin(), expected.end(), decoded.begin()));
+		
+		// above the threshold only
+		assert(ms::numpress::MSNumpress::decode(codecs[a], &encoded[0], encoded.size(), &decoded[0], 
+				ms::numpress::MSNumpress::STREAMING_THRESHOLD) == n);
+		assert(std::equal(expected.begin(), expected.end(), decoded.begin()));
+		
+		// through a buffer of the caller
+		std::vector<double> buffer(ms::numpress::MSNumpress::STREAM_BUFFER_SIZE);
+		std::fill(decoded.begin(), decoded.end(), 0);
+		assert(ms::numpress::MSNumpress::decode(codecs[a], &encoded[0], encoded.size(), &decoded[0], 
+				1, &buffer[0]) == n);
+		assert(std::equal(expected.begin(), expected.end(), decoded.begin()));
+		
+		msnumpress_context *context = msnumpress_context_new();
+		size_t decodedSize;
+		msnumpress_set_streaming_threshold(context, 1);
+		assert(MSNUMPRESS_OK == msnumpress_decode_batch(context, static_cast<msnumpress_codec>(a), 
+				data, dataSizes, 3, &batch[0], batch.size(), offsets));
+		assert(std::equal(expected.begin(), expected.end(), batch.begin() + offsets[2]));
+		assert(MSNUMPRESS_OK == msnumpress_decode(context, static_cast<msnumpress_codec>(a), 
+				&encoded[0], encoded.size(), &decoded[0], decoded.size(), &decodedSize));
+		assert(decodedSize == n);
+		assert(std::equal(expected.begin(), expected.end(), decoded.begin()));
+		msnumpress_context_free(context);
+	}
+	
+	cout << "+ pass    decodeStreaming " << endl << endl;
+}
+
+
+
+void decodeArena() {
+	srand(123459);
+	
+	size_t n = 1000, arrays = 3;
+	std::vector<std::vector<unsigned char> > encoded(arrays);
+	std::vector<std::vector<double> > expected(arrays);
+	const unsigned char *data[3];
+	size_t sizes[3], offsets[4];
+	for (size_t a=0; a<arrays; a++) {
+		std::vector<double> ics(n);
+		for (size_t i=0; i<n; i++) ics[i] = rand() % 100000;
+		ms::numpress::MSNumpress::encodePic(ics, encoded[a]);
+		ms::numpress::MSNumpress::decodePic(encoded[a], expected[a]);
+		data[a] = &encoded[a][0];
+		sizes[a] = encoded[a].size();
+	}
+	
+	// explicit huge pages fall back to transparent or regular ones
+	ms::numpress::MSNumpress::HugePageArena arena(1 << 20, ms::numpress::MSNumpress::HUGE_PAGES_EXPLICIT);
+	assert(arena.capacity() == ms::numpress::MSNumpress::HUGE_PAGE_SIZE);
+	cout << "+           pages: " << arena.hugePages() << endl;
+	
+	// consecutive batches follow each other at ARENA_ALIGNMENT
+	double *first, *second;
+	assert(ms::numpress::MSNumpress::decodeBatch(ms::numpress::MSNumpress::CV_NUMPRESS_PIC, 
+			data, sizes, arrays, arena, offsets, &first) == 3 * n);
+	assert(reinterpret_cast<size_t>(first) % ms::numpress::MSNumpress::ARENA_ALIGNMENT == 0);
+	for (size_t a=0; a<arrays; a++) 
+		assert(std::equal(expected[a].begin(), expected[a].end(), first + offsets[a]));
+	assert(arena.used() == 3 * n * sizeof(double));
+	
+	assert(ms::numpress::MSNumpress::decodeBatch(ms::numpress::MSNumpress::CV_NUMPRESS_PIC, 
+			&data[1], &sizes[1], 1, arena, offsets, &second) == n);
+	assert(second == first + 3 * n);
+	assert(std::equal(expected[1].begin(), expected[1].end(), second));
+	
+	try {
+		arena.allocate(arena.capacity());
+		cout << "- fail    decodeArena: didn't throw exception for full arena " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	
+	// corrupt data gives its room back
+	size_t used = arena.used();
+	try {
+		unsigned char corrupt[2] = { 0x2f, 0xff };
+		const unsigned char *corruptData = corrupt;
+		size_t corruptSize = 2;
+		ms::numpress::MSNumpress::decodeBatch(ms::numpress::MSNumpress::CV_NUMPRESS_LINEAR, 
+				&corruptData, &corruptSize, 1, arena, offsets, &second);
+		cout << "- fail    decodeArena: didn't throw exception for corrupt data " << endl << endl;
+		assert(0 == 1);
+	} catch (const char *err) {
+		
+	}
+	assert(arena.used() <= used + ms::numpress::MSNumpress::ARENA_ALIGNMENT);
+	
+	arena.reset();
+	assert(arena.used() == 0);
+	
+#ifdef MSNUMPRESS_PMR
+	ms::numpress::MSNumpress::HugePageResource resource(arena);
+	std::pmr::vector<double> values(&resource);
+	ms::numpress::MSNumpress::decode(ms::numpress::MSNumpress::CV_NUMPRESS_PIC, data[2], sizes[2], values);
+	assert(values.size() == n);
+	assert(std::equal(expected[2].begin(), expected[2].end(), values.begin()));
+	assert(arena.used() == n * sizeof(double));
+	assert(values.get_allocator().resource() == &resource);
+	assert(reinterpret_cast<size_t>(values.data()) % ms::numpress::MSNumpress::ARENA_ALIGNMENT == 0);
+	
+	try {
+		values.resize(arena.capacity());
+		cout << "- fail    decodeArena: didn't throw bad_alloc for full arena " << endl << endl;
+		assert(0 == 1);
+	} catch (const std::bad_alloc &) {
+		
+	}
+#endif
+	
+	cout << "+ pass    decodeArena " << endl << endl;
+}
+
+
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+/**
+ * Source for decodeBlocksAsync handing out 5 bytes per read.
+ */
+struct ChunkSource {
+	struct Read {
+		ChunkSource *source;
+		bool await_ready() { return true; }
+		void await_suspend(std::coroutine_handle<>) {}
+		std::span<const unsigned char> await_resume() {
+			size_t n = std::min<size_t>(5, source->data->size() - source->pos);
+			source->pos += n;
+			return std::span<const unsigned char>(source->data->data() + source->pos - n, n);
+		}
+	};
+	
+	const std::vector<unsigned char> *data;
+	size_t pos;
+	
+	Read read() { return Read{this}; }
+};
+
+/**
+ * Source for decodeBlocksAsync that suspends on every read, until the test
+ * resumes it, as a source completing reads from an event loop.
+ */
+struct SuspendingSource {
+	struct Read {
+		SuspendingSource *source;
+		bool await_ready() { return false; }
+		void await_suspend(std::coroutine_handle<> reader) { source->pending = reader; }
+		std::span<const unsigned char> await_resume() { return source->chunks.read().await_resume(); }
+	};
+	
+	ChunkSource chunks;
+	std::coroutine_handle<> pending;
+	
+	Read read() { return Read{this}; }
+};
+
+/**
+ * Eagerly started coroutine, for consuming an AsyncGenerator in a test.
+ */
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+template <class Source>
+Detached sumBlocksAsync(Source &source, size_t blockSize, double *sum, size_t *count) {
+	ms::numpress::MSNumpress::AsyncGenerator<std::span<const double> > blocks = 
+			ms::numpress::MSNumpress::decodeBlocksAsync(
+				ms::numpress::MSNumpress::BLOCK_LINEAR, source, blockSize);
+	while (const std::span<const double> *block = co_await blocks.next()) {
+		for (double x : *block) *sum += x;
+		*count += block->size();
+	}
+}
+
+
+
+void decodeBlocksCoroutines() {
+	srand(123459);
+	
+	size_t n = 10000;
+	std::vector<double> mzs(n), decoded;
+	mzs[0] = 300 + rand() / double(RAND_MAX);
+	for (size_t i=1; i<n; i++) 
+		mzs[i] = mzs[i-1] + rand() / double(RAND_MAX);
+	
+	std::vector<unsigned char> encoded;
+	ms::numpress::MSNumpress::encodeLinear(mzs, encoded, 
+			ms::numpress::MSNumpress::optimalLinearFixedPoint(&mzs[0], n));
+	ms::numpress::MSNumpress::decodeLinear(encoded, decoded);
+	
+	double expectedSum = 0;
+	for (size_t i=0; i<n; i++) expectedSum += decoded[i];
+	
+	size_t count = 0;
+	for (std::span<const double> block : ms::numpress::MSNumpress::decodeBlocks(
+			ms::numpress::MSNumpress::BLOCK_LINEAR, &encoded[0], encoded.size())) {
+		assert(block.size() <= ms::numpress::MSNumpress::CORO_BLOCK_SIZE);
+		for (size_t i=0; i<block.size(); i++) 
+			assert(block[i] == decoded[count + i]);
+		count += block.size();
+	}
+	assert(count == n);
+	
+	ChunkSource source;
+	source.data = &encoded;
+	source.pos = 0;
+	double sum = 0;
+	count = 0;
+	sumBlocksAsync(source, 100, &sum, &count);
+	assert(count == n);
+	assert(sum == expectedSum);
+	
+	SuspendingSource suspending;
+	suspending.chunks.data = &encoded;
+	suspending.chunks.pos = 0;
+	sum = 0;
+	count = 0;
+	sumBlocksAsync(suspending, 100, &sum, &count);
+	while (suspending.pending) 
+		std::exchange(suspending.pending, nullptr).resume();
+	assert(count == n);
+	assert(sum == expectedSum);
+	
+	// a block per value from a source that never suspends, so that the
+	// generator and the consumer hand over to each other a million times
+	std::vector<double> steps(1000000);
+	for (size_t i=0; i<steps.size(); i++) steps[i] = i * 0.5;
+	ms::numpress::MSNumpress::encodeLinear(steps, encoded, 2);
+	source.pos = 0;
+	sum = 0;
+	count = 0;
+	sumBlocksAsync(source, 1, &sum, &count);
+	assert(count == steps.size());
+	assert(sum == 0.5 * steps.size() * (steps.size() - 1) / 2);
+	
+	cout << "+ pass    decodeBlocksCoroutines " << endl << endl;
+}
+
+#endif
+
+
+
 void testErroneousDecodePic() {
 	std::vector<double> result;
 
@@ -665,14 +1984,35 @@ int main(int argc, const char* argv[]) {
 	decodeLinearCorrupt2();
 	encodeDecodeLinearStraight();
 	encodeDecodeLinear();
+	encodeDecodeLinearRuns();
 	encodeDecodePic();
 	encodeDecodeSafeStraight();
 	encodeDecodeSafe();
+	encodeDecodeShuffled();
+	encodeDecodePicSqrt();
 	optimalSlofFixedPoint();
 	encodeDecodeSlof();
+	encodeSlofFast();
 	encodeDecodeLinear5();
 	encodeDecodePic5();
 	encodeDecodeSlof5();
+	decodeSlofLogHalf();
+	encodeDecodeSlofLinear();
+	encodeDecodeStep();
+	encodeDecodeCalibrated();
+	encodeDecodeSpectrum();
+	decodeBlocks();
+	decodeVisitBlocks();
+	lazyDecodedArray();
+	decodeCached();
+	cvAccessionRegistry();
+	cInterface();
+	encodeRealtime();
+	decodeStreaming();
+	decodeArena();
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+	decodeBlocksCoroutines();
+#endif
 	testErroneousDecodePic();
 	
 	cout << "=== all tests succeeded! ===" << endl;
@@ -21,6 +21,12 @@
 
 using System;
 using System.Diagnostics;
+#if NETCOREAPP3_0_OR_GREATER
+using System.Numerics;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.X86;
+#endif
 
 /// <summary>
 /// Implementations of two compression schemes for numeric data from mass spectrometers.
@@ -603,4 +609,428 @@ public class MSNumpress
             return res;
         }
     }
+
+#if NETCOREAPP3_0_OR_GREATER
+    /////////////////////////////////////////////////////////////////////////////////
+    // Span overloads, for .NET Core 3.0 and later. They read and write caller memory
+    // directly and allocate nothing, so decoding one spectrum after another creates
+    // no garbage. The span lengths take the place of the dataSize arguments, and 
+    // results are identical to those of the array methods above.
+
+    public static void encodeFixedPoint(double fixedPoint, Span<byte> result)
+    {
+        long fp = BitConverter.DoubleToInt64Bits(fixedPoint);
+
+        for (int i = 0; i < 8; i++)
+        {
+            result[7 - i] = (byte)((fp >> (8 * i)) & 0xff);
+        }
+    }
+
+    public static double decodeFixedPoint(ReadOnlySpan<byte> data)
+    {
+        long fp = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            fp = fp | ((0xFFL & data[7 - i]) << (8 * i));
+        }
+
+        return BitConverter.Int64BitsToDouble(fp);
+    }
+
+    /// <summary>
+    /// Encodes x into halfbytes from res[0], as encodeInt(x, res, 0).
+    /// </summary>
+    /// <returns>the number of resulting halfbytes</returns>
+    public static int encodeInt(long x, Span<byte> res)
+    {
+        byte i, l;
+        long m;
+        long mask = 0xf0000000;
+        long init = x & mask;
+
+        if (init == 0)
+        {
+            l = 8;
+            for (i = 0; i < 8; i++)
+            {
+                m = mask >> (4 * i);
+                if ((x & m) != 0)
+                {
+                    l = i;
+                    break;
+                }
+            }
+            res[0] = l;
+            for (i = l; i < 8; i++)
+                res[1 + i - l] = (byte)(0xf & (x >> (4 * (i - l))));
+
+            return 1 + 8 - l;
+        }
+        else if (init == mask)
+        {
+            l = 7;
+            for (i = 0; i < 8; i++)
+            {
+                m = mask >> (4 * i);
+                if ((x & m) != m)
+                {
+                    l = i;
+                    break;
+                }
+            }
+            res[0] = (byte)(l | 8);
+            for (i = l; i < 8; i++)
+                res[1 + i - l] = (byte)(0xf & (x >> (4 * (i - l))));
+
+            return 1 + 8 - l;
+        }
+        else
+        {
+            res[0] = 0;
+            for (i = 0; i < 8; i++)
+                res[1 + i] = (byte)(0xf & (x >> (4 * i)));
+
+            return 9;
+        }
+    }
+
+    /// <summary>
+    /// Appends the encoded x to the halfbytes pending in halfBytes, and moves 
+    /// whole bytes to result from ri. 
+    /// </summary>
+    private static void encodeIntInto(long x, Span<byte> halfBytes, ref int halfByteCount, Span<byte> result, ref int ri)
+    {
+        int hbi;
+
+        halfByteCount += encodeInt(x, halfBytes.Slice(halfByteCount));
+
+        for (hbi = 1; hbi < halfByteCount; hbi += 2)
+            result[ri++] = (byte)((halfBytes[hbi - 1] << 4) | (halfBytes[hbi] & 0xf));
+
+        if (halfByteCount % 2 != 0)
+        {
+            halfBytes[0] = halfBytes[halfByteCount - 1];
+            halfByteCount = 1;
+        }
+        else
+            halfByteCount = 0;
+    }
+
+    public static double optimalLinearFixedPoint(ReadOnlySpan<double> data)
+    {
+        if (data.Length == 0) return 0;
+        if (data.Length == 1) return Math.Floor(0xFFFFFFFFL / data[0]);
+        double maxDouble = Math.Max(data[0], data[1]);
+
+        for (int i = 2; i < data.Length; i++)
+        {
+            double extrapol = data[i - 1] + (data[i - 1] - data[i - 2]);
+            double diff = data[i] - extrapol;
+            maxDouble = Math.Max(maxDouble, Math.Ceiling(Math.Abs(diff) + 1));
+        }
+
+        return Math.Floor(0x7FFFFFFFL / maxDouble);
+    }
+
+    /// <summary>
+    /// Encodes data with linear prediction into result, which needs room for
+    /// 8 + data.Length * 5 bytes. See encodeLinear(double[], int, byte[], double).
+    /// </summary>
+    /// <returns>the number of encoded bytes</returns>
+    public static int encodeLinear(ReadOnlySpan<double> data, Span<byte> result, double fixedPoint)
+    {
+        long ints0, ints1, ints2;
+        int i;
+        int ri;
+        Span<byte> halfBytes = stackalloc byte[10];
+        int halfByteCount = 0;
+
+        encodeFixedPoint(fixedPoint, result);
+
+        if (data.Length == 0) return 8;
+
+        ints1 = (long)(data[0] * fixedPoint + 0.5);
+        for (i = 0; i < 4; i++)
+        {
+            result[8 + i] = (byte)((ints1 >> (i * 8)) & 0xff);
+        }
+
+        if (data.Length == 1) return 12;
+
+        ints2 = (long)(data[1] * fixedPoint + 0.5);
+        for (i = 0; i < 4; i++)
+        {
+            result[12 + i] = (byte)((ints2 >> (i * 8)) & 0xff);
+        }
+
+        ri = 16;
+
+        for (i = 2; i < data.Length; i++)
+        {
+            ints0 = ints1;
+            ints1 = ints2;
+            ints2 = (long)(data[i] * fixedPoint + 0.5);
+            encodeIntInto(ints2 - (ints1 + (ints1 - ints0)), halfBytes, ref halfByteCount, result, ref ri);
+        }
+
+        if (halfByteCount == 1)
+            result[ri++] = (byte)(halfBytes[0] << 4);
+
+        return ri;
+    }
+
+    /// <summary>
+    /// Decodes data encoded by encodeLinear into result, which needs room for
+    /// (data.Length - 8) * 2 doubles. See decodeLinear(byte[], int, double[]).
+    /// </summary>
+    /// <returns>the number of decoded doubles, or -1 if data.Length &lt; 8 or is 9 to 11 or 13 to 15</returns>
+    public static int decodeLinear(ReadOnlySpan<byte> data, Span<double> result)
+    {
+        long ints1 = 0, ints2 = 0;
+
+        if (data.Length == 8) return 0;
+        if (data.Length < 8) return -1;
+        double fixedPoint = decodeFixedPoint(data);
+        if (data.Length < 12) return -1;
+
+        for (int i = 0; i < 4; i++)
+        {
+            ints1 = ints1 | ((0xFFL & data[8 + i]) << (i * 8));
+        }
+        result[0] = ints1 / fixedPoint;
+
+        if (data.Length == 12) return 1;
+        if (data.Length < 16) return -1;
+
+        for (int i = 0; i < 4; i++)
+        {
+            ints2 = ints2 | ((0xFFL & data[12 + i]) << (i * 8));
+        }
+        result[1] = ints2 / fixedPoint;
+
+        return decodeInts(data, 16, result, 2, true, ints1, ints2, fixedPoint);
+    }
+
+    /// <summary>
+    /// Encodes ion counts into result, which needs room for data.Length * 5 
+    /// bytes. See encodePic(double[], int, byte[]).
+    /// </summary>
+    /// <returns>the number of encoded bytes</returns>
+    public static int encodePic(ReadOnlySpan<double> data, Span<byte> result)
+    {
+        int ri = 0;
+        Span<byte> halfBytes = stackalloc byte[10];
+        int halfByteCount = 0;
+
+        for (int i = 0; i < data.Length; i++)
+            encodeIntInto((long)(data[i] + 0.5), halfBytes, ref halfByteCount, result, ref ri);
+
+        if (halfByteCount == 1)
+            result[ri++] = (byte)(halfBytes[0] << 4);
+
+        return ri;
+    }
+
+    /// <summary>
+    /// Decodes data encoded by encodePic into result, which needs room for 
+    /// data.Length * 2 doubles. See decodePic(byte[], int, double[]).
+    /// </summary>
+    /// <returns>the number of decoded doubles</returns>
+    public static int decodePic(ReadOnlySpan<byte> data, Span<double> result)
+    {
+        return decodeInts(data, 0, result, 0, false, 0, 0, 1);
+    }
+
+    public static double optimalSlofFixedPoint(ReadOnlySpan<double> data)
+    {
+        if (data.Length == 0) return 0;
+
+        double maxDouble = 1;
+
+        for (int i = 0; i < data.Length; i++)
+            maxDouble = Math.Max(maxDouble, Math.Log(data[i] + 1));
+
+        return Math.Floor(0xFFFF / maxDouble);
+    }
+
+    /// <summary>
+    /// Encodes ion counts into result, which needs room for data.Length * 2 + 8
+    /// bytes. See encodeSlof(double[], int, byte[], double).
+    /// </summary>
+    /// <returns>the number of encoded bytes</returns>
+    public static int encodeSlof(ReadOnlySpan<double> data, Span<byte> result, double fixedPoint)
+    {
+        int x;
+        int ri = 8;
+
+        encodeFixedPoint(fixedPoint, result);
+
+        for (int i = 0; i < data.Length; i++)
+        {
+            x = (int)(Math.Log(data[i] + 1) * fixedPoint + 0.5);
+
+            result[ri++] = (byte)(0xff & x);
+            result[ri++] = (byte)(x >> 8);
+        }
+        return ri;
+    }
+
+    /// <summary>
+    /// Decodes data encoded by encodeSlof into result, which needs room for 
+    /// (data.Length - 8) / 2 doubles. See decodeSlof(byte[], int, double[]).
+    /// </summary>
+    /// <returns>the number of decoded doubles, or -1 if data is not 8 bytes plus whole shorts</returns>
+    /// <remarks>
+    /// With AVX, the shorts are widened and divided by the fixed point four at a 
+    /// time, and the exponentials taken in a second pass over result.
+    /// </remarks>
+    public static int decodeSlof(ReadOnlySpan<byte> data, Span<double> result)
+    {
+        int x;
+        int ri = 0;
+        int i = 8;
+
+        if (data.Length < 8) return -1;
+        double fixedPoint = decodeFixedPoint(data);
+
+        if (data.Length % 2 != 0) return -1;
+
+        int n = (data.Length - 8) / 2;
+        result = result.Slice(0, n);
+
+        if (Avx.IsSupported && Sse41.IsSupported)
+        {
+            Vector256<double> fp = Vector256.Create(fixedPoint);
+            Span<Vector256<double>> quotients = MemoryMarshal.Cast<double, Vector256<double>>(result);
+
+            for (; ri < quotients.Length * 4; ri += 4, i += 8)
+            {
+                Vector128<ushort> shorts = Vector128.CreateScalarUnsafe(MemoryMarshal.Read<ulong>(data.Slice(i))).AsUInt16();
+                Vector128<int> ints = Sse41.ConvertToVector128Int32(shorts);
+                quotients[ri / 4] = Avx.Divide(Avx.ConvertToVector256Double(ints), fp);
+            }
+            for (int qi = 0; qi < ri; qi++)
+                result[qi] = Math.Exp(result[qi]) - 1;
+        }
+
+        for (; i < data.Length; i += 2)
+        {
+            x = (0xff & data[i]) | ((0xff & data[i + 1]) << 8);
+            result[ri++] = Math.Exp((0xffff & x) / fixedPoint) - 1;
+        }
+        return ri;
+    }
+
+    // Number of halfbytes following each head halfbyte, and the leading ones 
+    // it fills in, see IntDecoder.next().
+    private static readonly int[] TAIL_LENGTH = { 8, 7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1 };
+    private static readonly int[] HEAD_FILL = { 
+        0, 0, 0, 0, 0, 0, 0, 0, 0,
+        unchecked((int)0xf0000000), unchecked((int)0xff000000), unchecked((int)0xfff00000), unchecked((int)0xffff0000),
+        unchecked((int)0xfffff000), unchecked((int)0xffffff00), unchecked((int)0xfffffff0) };
+
+    /// <summary>
+    /// Decodes the ints in the halfbytes of data from byte start in one pass into
+    /// result from ri, stopping like repeated calls to IntDecoder.next() in 
+    /// decodeLinear and decodePic. If linear, the ints are residuals from the 
+    /// prediction from the fixed point values prev0 and prev1, and value / fixedPoint 
+    /// is stored, otherwise the ints themselves.
+    /// </summary>
+    /// <returns>the index in result after the last decoded value</returns>
+    /// <remarks>
+    /// Bytes at a byte boundary holding two zeros (0x88) or one int of one
+    /// halfbyte (heads 7 and 15) are taken whole. With SSE2, runs of 0x88, common
+    /// in ion count arrays, are found 16 bytes at a time.
+    /// </remarks>
+    private static int decodeInts(ReadOnlySpan<byte> data, int start, Span<double> result, int ri, bool linear, long prev0, long prev1, double fixedPoint)
+    {
+        int hi = 2 * start;  // halfbyte index
+        int end = 2 * data.Length;
+        int b, head, tail, x, k;
+        long y;
+        Vector128<byte> zeros = Vector128.Create((byte)0x88);
+
+        while (hi < end)
+        {
+            // at a byte boundary, take bytes holding one or two ints whole
+            if ((hi & 1) == 0)
+            {
+                b = data[hi >> 1];
+                if (b == 0x88)
+                {
+                    if (linear)
+                    {
+                        y = 2 * prev1 - prev0;
+                        prev0 = prev1;
+                        prev1 = y;
+                        result[ri++] = y / fixedPoint;
+                        y = 2 * prev1 - prev0;
+                        prev0 = prev1;
+                        prev1 = y;
+                        result[ri++] = y / fixedPoint;
+                        hi += 2;
+                    }
+                    else
+                    {
+                        int run = 1;
+                        if (Sse2.IsSupported)
+                        {
+                            while ((hi >> 1) + run + 16 <= data.Length)
+                            {
+                                Vector128<byte> bytes = MemoryMarshal.Read<Vector128<byte>>(data.Slice((hi >> 1) + run));
+                                int equal = Sse2.MoveMask(Sse2.CompareEqual(bytes, zeros));
+                                run += BitOperations.TrailingZeroCount(~equal);
+                                if (equal != 0xffff) break;
+                            }
+                        }
+                        result.Slice(ri, 2 * run).Clear();
+                        ri += 2 * run;
+                        hi += 2 * run;
+                    }
+                    continue;
+                }
+                head = b >> 4;
+                if (head == 7 || head == 15)
+                {
+                    x = HEAD_FILL[head] | (b & 0xf);
+                    hi += 2;
+                }
+                else
+                {
+                    hi++;
+                    tail = TAIL_LENGTH[head];
+                    x = HEAD_FILL[head];
+                    for (k = 0; k < tail; k++, hi++)
+                        x |= ((data[hi >> 1] >> (((~hi) & 1) << 2)) & 0xf) << (4 * k);
+                }
+            }
+            else
+            {
+                head = data[hi >> 1] & 0xf;
+                // a last 0x0 halfbyte is padding, see decodePic(byte[], int, double[])
+                if (hi == end - 1 && head != 0x8)
+                    break;
+                hi++;
+                tail = TAIL_LENGTH[head];
+                x = HEAD_FILL[head];
+                for (k = 0; k < tail; k++, hi++)
+                    x |= ((data[hi >> 1] >> (((~hi) & 1) << 2)) & 0xf) << (4 * k);
+            }
+
+            if (linear)
+            {
+                y = 2 * prev1 - prev0 + x;
+                prev0 = prev1;
+                prev1 = y;
+                result[ri++] = y / fixedPoint;
+            }
+            else
+            {
+                result[ri++] = x;
+            }
+        }
+        return ri;
+    }
+#endif
 }
\ No newline at end of file
@@ -330,4 +330,85 @@ public class MSNumpressTest
         for (int i = 0; i < n; i++)
             Assert.AreEqual(firstDecoded[i], decoded[i], double.Epsilon);
     }
+
+#if NETCOREAPP3_0_OR_GREATER
+    [TestMethod]
+    public void spanLinearMatchesArrays()
+    {
+        Random random = new Random();
+        int n = 1000;
+        double[] mzs = new double[n];
+        mzs[0] = 300 + random.NextDouble();
+        for (int i = 1; i < n; i++)
+            mzs[i] = mzs[i - 1] + random.NextDouble();
+
+        byte[] encoded = new byte[n * 5 + 8];
+        double fixedPoint = MSNumpress.optimalLinearFixedPoint(mzs, n);
+        Assert.AreEqual(fixedPoint, MSNumpress.optimalLinearFixedPoint(new ReadOnlySpan<double>(mzs)));
+        int encodedBytes = MSNumpress.encodeLinear(mzs, n, encoded, fixedPoint);
+
+        Span<byte> spanEncoded = new byte[n * 5 + 8];
+        Assert.AreEqual(encodedBytes, MSNumpress.encodeLinear(new ReadOnlySpan<double>(mzs), spanEncoded, fixedPoint));
+        Assert.IsTrue(spanEncoded.Slice(0, encodedBytes).SequenceEqual(new ReadOnlySpan<byte>(encoded, 0, encodedBytes)));
+
+        double[] decoded = new double[n];
+        double[] spanDecoded = new double[n];
+        Assert.AreEqual(n, MSNumpress.decodeLinear(encoded, encodedBytes, decoded));
+        Assert.AreEqual(n, MSNumpress.decodeLinear(new ReadOnlySpan<byte>(encoded, 0, encodedBytes), spanDecoded));
+        for (int i = 0; i < n; i++)
+            Assert.AreEqual(decoded[i], spanDecoded[i], 0);
+    }
+
+    [TestMethod]
+    public void spanPicMatchesArrays()
+    {
+        Random random = new Random();
+        int n = 1000;
+        double[] ics = new double[n];
+        // runs of zeros, as between peaks, and negative counts
+        for (int i = 0; i < n; i++)
+            ics[i] = random.Next(4) == 0 ? Math.Pow(10, 6 * random.NextDouble()) : (i % 50 < 40 ? 0 : -random.Next(100));
+
+        byte[] encoded = new byte[n * 5];
+        int encodedBytes = MSNumpress.encodePic(ics, n, encoded);
+
+        Span<byte> spanEncoded = new byte[n * 5];
+        Assert.AreEqual(encodedBytes, MSNumpress.encodePic(new ReadOnlySpan<double>(ics), spanEncoded));
+        Assert.IsTrue(spanEncoded.Slice(0, encodedBytes).SequenceEqual(new ReadOnlySpan<byte>(encoded, 0, encodedBytes)));
+
+        double[] decoded = new double[n * 2];
+        double[] spanDecoded = new double[n * 2];
+        int decodedDoubles = MSNumpress.decodePic(encoded, encodedBytes, decoded);
+        Assert.AreEqual(n, decodedDoubles);
+        Assert.AreEqual(decodedDoubles, MSNumpress.decodePic(new ReadOnlySpan<byte>(encoded, 0, encodedBytes), spanDecoded));
+        for (int i = 0; i < n; i++)
+            Assert.AreEqual(decoded[i], spanDecoded[i], 0);
+    }
+
+    [TestMethod]
+    public void spanSlofMatchesArrays()
+    {
+        Random random = new Random();
+        int n = 1001;
+        double[] ics = new double[n];
+        for (int i = 0; i < n; i++)
+            ics[i] = Math.Pow(10, 6 * random.NextDouble());
+
+        byte[] encoded = new byte[n * 2 + 8];
+        double fixedPoint = MSNumpress.optimalSlofFixedPoint(ics, n);
+        Assert.AreEqual(fixedPoint, MSNumpress.optimalSlofFixedPoint(new ReadOnlySpan<double>(ics)));
+        int encodedBytes = MSNumpress.encodeSlof(ics, n, encoded, fixedPoint);
+
+        Span<byte> spanEncoded = new byte[n * 2 + 8];
+        Assert.AreEqual(encodedBytes, MSNumpress.encodeSlof(new ReadOnlySpan<double>(ics), spanEncoded, fixedPoint));
+        Assert.IsTrue(spanEncoded.SequenceEqual(encoded));
+
+        double[] decoded = new double[n];
+        double[] spanDecoded = new double[n];
+        Assert.AreEqual(n, MSNumpress.decodeSlof(encoded, encodedBytes, decoded));
+        Assert.AreEqual(n, MSNumpress.decodeSlof(new ReadOnlySpan<byte>(encoded), spanDecoded));
+        for (int i = 0; i < n; i++)
+            Assert.AreEqual(decoded[i], spanDecoded[i], 0);
+    }
+#endif
 }
\ No newline at end of file
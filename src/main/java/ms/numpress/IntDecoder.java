@@ -73,4 +73,120 @@ class IntDecoder {
 		
 		return res;
 	}
+	
+	
+	
+	/**
+	 * Number of halfbytes following each head halfbyte.
+	 */
+	static final int[] TAIL_LENGTH = new int[16];
+	
+	/**
+	 * Leading ones filled in by each head halfbyte.
+	 */
+	static final int[] HEAD_FILL = new int[16];
+	
+	/**
+	 * For bytes starting at a byte boundary that hold exactly one int (a head
+	 * of 7 or 15 and one halfbyte), that int.
+	 */
+	static final int[] BYTE_VALUE = new int[256];
+	
+	static {
+		for (int head=0; head<16; head++) {
+			int n = head <= 8 ? head : head - 8;
+			TAIL_LENGTH[head] 	= 8 - n;
+			HEAD_FILL[head] 	= head <= 8 ? 0 : 0xffffffff << (4 * (8 - n));
+		}
+		for (int b=0; b<256; b++) 
+			BYTE_VALUE[b] = HEAD_FILL[b >> 4] | (b & 0xf);
+	}
+	
+	
+	/**
+	 * Decodes all ints in the halfbytes of data from byte start up to byte 
+	 * dataSize in one pass, into result from index ri. Decodes the same ints
+	 * as repeated calls to next(), stopping at the same point, but looks 
+	 * lengths up in tables and takes whole bytes at a time where they hold 
+	 * one or two ints.
+	 * 
+	 * If linear, the ints are residuals of the linear prediction from the two
+	 * previous fixed point values, starting from prev0 and prev1, and
+	 * value / fixedPoint is stored, as in MSNumpress.decodeLinear. Otherwise
+	 * the ints themselves are stored, as in MSNumpress.decodePic.
+	 * 
+	 * @return		the index in result after the last decoded value
+	 */
+	static int decodeAll(
+			byte[] data, 
+			int start, 
+			int dataSize, 
+			double[] result, 
+			int ri,
+			boolean linear,
+			long prev0,
+			long prev1,
+			double fixedPoint
+	) {
+		int hi = 2 * start;		// halfbyte index
+		int end = 2 * dataSize;
+		int b, head, tail, x, k;
+		long y;
+		
+		while (hi < end) {
+			// at a byte boundary, take bytes holding one or two ints whole
+			if ((hi & 1) == 0) {
+				b = 0xff & data[hi >> 1];
+				if (b == 0x88) {
+					if (linear) {
+						y = 2 * prev1 - prev0;
+						prev0 = prev1;
+						prev1 = y;
+						result[ri++] = y / fixedPoint;
+						y = 2 * prev1 - prev0;
+						prev0 = prev1;
+						prev1 = y;
+						result[ri++] = y / fixedPoint;
+					} else {
+						result[ri++] = 0;
+						result[ri++] = 0;
+					}
+					hi += 2;
+					continue;
+				}
+				head = b >> 4;
+				if (head == 7 || head == 15) {
+					x = BYTE_VALUE[b];
+					hi += 2;
+				} else {
+					hi++;
+					tail = TAIL_LENGTH[head];
+					x = HEAD_FILL[head];
+					for (k=0; k<tail; k++, hi++) 
+						x |= ((data[hi >> 1] >> (((~hi) & 1) << 2)) & 0xf) << (4 * k);
+				}
+				
+			} else {
+				head = data[hi >> 1] & 0xf;
+				// a last 0x0 halfbyte is padding, see next()
+				if (hi == end - 1 && head != 0x8) 
+					break;
+				hi++;
+				tail = TAIL_LENGTH[head];
+				x = HEAD_FILL[head];
+				for (k=0; k<tail; k++, hi++) 
+					x |= ((data[hi >> 1] >> (((~hi) & 1) << 2)) & 0xf) << (4 * k);
+			}
+			
+			if (linear) {
+				y = 2 * prev1 - prev0 + x;
+				prev0 = prev1;
+				prev1 = y;
+				result[ri++] = y / fixedPoint;
+			} else {
+				result[ri++] = x;
+			}
+		}
+		return ri;
+	}
 }
@@ -302,11 +302,7 @@ public class MSNumpress {
 			int dataSize, 
 			double[] result
 	) {
-		int ri = 2;
 		long[] ints = new long[3];
-		long extrapol;
-		long y;
-		IntDecoder dec = new IntDecoder(data, 16);
 
 		if (dataSize == 8) return 0;
 		if (dataSize < 8) return -1;
@@ -328,22 +324,7 @@ public class MSNumpress {
 		}
 		result[1] = ints[2] / fixedPoint;
 	
-		while (dec.pos < dataSize) {
-			if (dec.pos == (dataSize - 1) && dec.half)
-				if ((data[dec.pos] & 0xf) != 0x8)
-					break;
-			
-			ints[0] = ints[1];
-			ints[1] = ints[2];
-			ints[2] = dec.next();
-			
-			extrapol = ints[1] + (ints[1] - ints[0]);
-			y = extrapol + ints[2];
-			result[ri++] = y / fixedPoint;
-			ints[2] = y;
-		}
-		
-		return ri;
+		return IntDecoder.decodeAll(data, 16, dataSize, result, 2, true, ints[1], ints[2], fixedPoint);
 	}
 	
 	
@@ -417,19 +398,7 @@ public class MSNumpress {
 			int dataSize, 
 			double[] result
 	) {
-		int ri = 0;
-		long count;
-		IntDecoder dec = new IntDecoder(data, 0);
-
-		while (dec.pos < dataSize) {
-			if (dec.pos == (dataSize - 1) && dec.half)
-				if ((data[dec.pos] & 0xf) != 0x8)
-					break;
-				
-			count = dec.next();
-			result[ri++] = count;
-		}
-		return ri;
+		return IntDecoder.decodeAll(data, 0, dataSize, result, 0, false, 0, 0, 1);
 	}
 	
 	
@@ -0,0 +1,221 @@
+/*
+	NativeMSNumpress.java
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+package ms.numpress;
+
+import java.nio.BufferOverflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.DoubleBuffer;
+
+/**
+ * Numpress encoding and decoding on NIO buffers, using the C++
+ * implementation through JNI when the native library msnumpress_jni
+ * (see src/main/cpp/MSNumpressJNI.cpp) can be loaded, and MSNumpress
+ * otherwise. Results are identical either way.
+ *
+ * The native path works on the memory of direct buffers without copies.
+ * DoubleBuffers need to be in native byte order for that, e.g. from
+ *
+ * 		ByteBuffer.allocateDirect(n * 8).order(ByteOrder.nativeOrder()).asDoubleBuffer()
+ *
+ * Other buffers are copied through arrays into MSNumpress.
+ *
+ * The native library is not loaded if the system property
+ * ms.numpress.native is "false".
+ */
+public class NativeMSNumpress {
+
+	/// codec numbers, as msnumpress_codec of MSNumpressC.h
+	public static final int LINEAR 	= 0;
+	public static final int PIC 	= 1;
+	public static final int SLOF 	= 2;
+
+	// msnumpress_status values of MSNumpressC.h
+	private static final int ERROR_ARGUMENT = 1;
+	private static final int ERROR_DATA 	= 2;
+	private static final int ERROR_BUFFER 	= 3;
+
+	private static final boolean AVAILABLE = loadLibrary();
+
+	private static boolean loadLibrary() {
+		if ("false".equals(System.getProperty("ms.numpress.native")))
+			return false;
+		try {
+			System.loadLibrary("msnumpress_jni");
+			return true;
+		} catch (UnsatisfiedLinkError e) {
+			return false;
+		} catch (SecurityException e) {
+			return false;
+		}
+	}
+
+	private static native int decodeNative(
+			int codec,
+			ByteBuffer data, int dataOffset, int dataSize,
+			DoubleBuffer result, int resultOffset, int resultCapacity);
+
+	private static native int encodeNative(
+			int codec,
+			DoubleBuffer data, int dataOffset, int dataSize,
+			double fixedPoint,
+			ByteBuffer result, int resultOffset, int resultCapacity);
+
+
+	/**
+	 * Whether the native library was loaded.
+	 */
+	public static boolean isAvailable() {
+		return AVAILABLE;
+	}
+
+
+	/**
+	 * The most doubles decoded from dataSize bytes encoded with codec.
+	 */
+	public static int decodeBound(int codec, int dataSize) {
+		if (codec == LINEAR) 	return dataSize <= 16 ? 2 : 2 + (dataSize - 16) * 2;
+		if (codec == PIC) 		return dataSize * 2;
+		return dataSize < 8 ? 0 : (dataSize - 8) / 2;
+	}
+
+
+	/**
+	 * The most bytes needed for encoding dataSize doubles with codec.
+	 */
+	public static int encodeBound(int codec, int dataSize) {
+		if (codec == LINEAR) 	return 8 + dataSize * 5;
+		if (codec == PIC) 		return dataSize * 5;
+		return 8 + dataSize * 2;
+	}
+
+
+	/**
+	 * Decodes the bytes from the position to the limit of data, encoded with
+	 * codec, into result from its position. The positions of data and result
+	 * are moved past the bytes read and the doubles written.
+	 *
+	 * Throws an IllegalArgumentException if the data is corrupt, and a
+	 * BufferOverflowException if the values do not fit in result.
+	 *
+	 * @codec		LINEAR, PIC or SLOF
+	 * @data		buffer of bytes to be decoded
+	 * @result		buffer were resulting doubles should be stored
+	 * @return		the number of decoded doubles
+	 */
+	public static int decode(
+			int codec,
+			ByteBuffer data,
+			DoubleBuffer result
+	) {
+		int dataSize = data.remaining();
+		int decoded;
+
+		if (AVAILABLE && data.isDirect() && result.isDirect() && result.order() == ByteOrder.nativeOrder()) {
+			decoded = check(decodeNative(codec,
+					data, data.position(), dataSize,
+					result, result.position(), result.remaining()));
+		} else {
+			byte[] bytes = new byte[dataSize];
+			data.duplicate().get(bytes);
+			double[] values = new double[decodeBound(codec, dataSize)];
+			if (codec == LINEAR) 		decoded = MSNumpress.decodeLinear(bytes, dataSize, values);
+			else if (codec == PIC) 		decoded = MSNumpress.decodePic(bytes, dataSize, values);
+			else if (codec == SLOF) 	decoded = MSNumpress.decodeSlof(bytes, dataSize, values);
+			else throw new IllegalArgumentException("Unknown numpress codec " + codec);
+			if (decoded < 0)
+				throw new IllegalArgumentException("Corrupt numpress data!");
+			if (decoded > result.remaining())
+				throw new BufferOverflowException();
+			result.duplicate().put(values, 0, decoded);
+		}
+		data.position(data.limit());
+		result.position(result.position() + decoded);
+		return decoded;
+	}
+
+
+	/**
+	 * Encodes the doubles from the position to the limit of data with codec
+	 * into result from its position, which needs encodeBound(codec,
+	 * data.remaining()) bytes remaining. The positions of data and result are
+	 * moved past the doubles read and the bytes written.
+	 *
+	 * @codec		LINEAR, PIC or SLOF
+	 * @data		buffer of doubles to be encoded
+	 * @result		buffer were resulting bytes should be stored
+	 * @fixedPoint	the scaling factor, ignored by PIC
+	 * @return		the number of encoded bytes
+	 */
+	public static int encode(
+			int codec,
+			DoubleBuffer data,
+			ByteBuffer result,
+			double fixedPoint
+	) {
+		int dataSize = data.remaining();
+		int encoded;
+
+		if (result.remaining() < encodeBound(codec, dataSize))
+			throw new BufferOverflowException();
+
+		if (AVAILABLE && data.isDirect() && result.isDirect() && data.order() == ByteOrder.nativeOrder()) {
+			encoded = check(encodeNative(codec,
+					data, data.position(), dataSize, fixedPoint,
+					result, result.position(), result.remaining()));
+		} else {
+			double[] values = new double[dataSize];
+			data.duplicate().get(values);
+			byte[] bytes = new byte[encodeBound(codec, dataSize)];
+			if (codec == LINEAR) 		encoded = MSNumpress.encodeLinear(values, dataSize, bytes, fixedPoint);
+			else if (codec == PIC) 		encoded = MSNumpress.encodePic(values, dataSize, bytes);
+			else if (codec == SLOF) 	encoded = MSNumpress.encodeSlof(values, dataSize, bytes, fixedPoint);
+			else throw new IllegalArgumentException("Unknown numpress codec " + codec);
+			result.duplicate().put(bytes, 0, encoded);
+		}
+		data.position(data.limit());
+		result.position(result.position() + encoded);
+		return encoded;
+	}
+
+
+	public static int decodeLinear(ByteBuffer data, DoubleBuffer result) {
+		return decode(LINEAR, data, result);
+	}
+
+	public static int decodePic(ByteBuffer data, DoubleBuffer result) {
+		return decode(PIC, data, result);
+	}
+
+	public static int decodeSlof(ByteBuffer data, DoubleBuffer result) {
+		return decode(SLOF, data, result);
+	}
+
+
+	/**
+	 * Turns negative native results into exceptions.
+	 */
+	private static int check(int result) {
+		if (result >= 0) 					return result;
+		if (result == -ERROR_BUFFER) 		throw new BufferOverflowException();
+		if (result == -ERROR_DATA) 			throw new IllegalArgumentException("Corrupt numpress data, or values that cannot be encoded!");
+		if (result == -ERROR_ARGUMENT) 		throw new IllegalArgumentException("Invalid buffers or codec!");
+		throw new IllegalStateException("Native numpress error " + (-result));
+	}
+}
@@ -20,6 +20,10 @@ package ms.numpress;
 
 import static org.junit.Assert.*;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.DoubleBuffer;
+
 import org.junit.Test;
 
 public class MSNumpressTest {
@@ -322,4 +326,95 @@ public class MSNumpressTest {
 		for (int i=0; i<n; i++) 
 			assertEquals(firstDecoded[i], decoded[i], Double.MIN_VALUE);
 	}
+
+
+	@Test
+	public void nativeEncodeDecodeBuffers() {
+		
+		int n = 1000;
+		double[] mzs = new double[n];
+		mzs[0] = 300 + Math.random();
+		for (int i=1; i<n; i++) 
+			mzs[i] = mzs[i-1] + Math.random();
+		
+		byte[] encoded 		= new byte[n * 5 + 8];
+		double fixedPoint	= MSNumpress.optimalLinearFixedPoint(mzs, n);
+		int encodedBytes 	= MSNumpress.encodeLinear(mzs, n, encoded, fixedPoint);
+		double[] decoded 	= new double[n];
+		MSNumpress.decodeLinear(encoded, encodedBytes, decoded);
+		
+		// direct buffers, native if the library is available
+		DoubleBuffer directMzs = ByteBuffer.allocateDirect(n * 8).order(ByteOrder.nativeOrder()).asDoubleBuffer();
+		directMzs.put(mzs).flip();
+		ByteBuffer directEncoded = ByteBuffer.allocateDirect(NativeMSNumpress.encodeBound(NativeMSNumpress.LINEAR, n));
+		NativeMSNumpress.encode(NativeMSNumpress.LINEAR, directMzs, directEncoded, fixedPoint);
+		directEncoded.flip();
+		
+		DoubleBuffer directDecoded = ByteBuffer.allocateDirect(n * 8).order(ByteOrder.nativeOrder()).asDoubleBuffer();
+		assertEquals(n, NativeMSNumpress.decodeLinear(directEncoded, directDecoded));
+		assertEquals(n, directDecoded.position());
+		for (int i=0; i<n; i++) 
+			assertEquals(mzs[i], directDecoded.get(i), 0.000005);
+		
+		// heap buffers always take the java path
+		DoubleBuffer heapDecoded = DoubleBuffer.allocate(n);
+		assertEquals(n, NativeMSNumpress.decodeLinear(ByteBuffer.wrap(encoded, 0, encodedBytes), heapDecoded));
+		for (int i=0; i<n; i++) 
+			assertEquals(decoded[i], heapDecoded.get(i), 0);
+		
+		try {
+			NativeMSNumpress.decodeLinear(ByteBuffer.wrap(encoded, 0, encodedBytes), DoubleBuffer.allocate(n - 1));
+			fail("decoding into a too small buffer should throw");
+		} catch (java.nio.BufferOverflowException e) {
+		}
+	}
+	
+	
+	@Test
+	public void decodeAllMatchesNext() {
+		java.util.Random random = new java.util.Random(123459);
+		byte[] halfbytes = { (byte)0x88, (byte)0x78, (byte)0xf3, (byte)0x8f, (byte)0x08, (byte)0x80 };
+		double[] bulk 		= new double[200];
+		double[] single 	= new double[200];
+		
+		for (int t=0; t<2000; t++) {
+			int dataSize = random.nextInt(40);
+			// trailing bytes, so that corrupt data reads past dataSize like next()
+			byte[] data = new byte[dataSize + 8];
+			for (int i=0; i<data.length; i++) 
+				data[i] = random.nextBoolean() 
+						? halfbytes[random.nextInt(halfbytes.length)] 
+						: (byte)random.nextInt(256);
+			
+			int ri = 0;
+			IntDecoder dec = new IntDecoder(data, 0);
+			while (dec.pos < dataSize) {
+				if (dec.pos == (dataSize - 1) && dec.half)
+					if ((data[dec.pos] & 0xf) != 0x8)
+						break;
+				single[ri++] = dec.next();
+			}
+			
+			assertEquals(ri, IntDecoder.decodeAll(data, 0, dataSize, bulk, 0, false, 0, 0, 1));
+			for (int i=0; i<ri; i++) 
+				assertEquals(single[i], bulk[i], 0);
+		}
+	}
+	
+	
+	@Test
+	public void encodeDecodePicZeros() {
+		int n = 1001;
+		double[] ics = new double[n];
+		for (int i=0; i<n; i++) 
+			ics[i] = i % 7 == 0 ? i * 1000 : 0;
+		
+		byte[] encoded 		= new byte[n * 5];
+		double[] decoded 	= new double[n * 2];
+		int encodedBytes 	= MSNumpress.encodePic(ics, n, encoded);
+		
+		assertEquals(n, MSNumpress.decodePic(encoded, encodedBytes, decoded));
+		for (int i=0; i<n; i++) 
+			assertEquals(ics[i], decoded[i], 0);
+	}
 }
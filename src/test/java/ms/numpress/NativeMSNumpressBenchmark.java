@@ -0,0 +1,143 @@
+/*
+	NativeMSNumpressBenchmark.java
+	johan.teleman@immun.lth.se
+
+	Copyright 2013 Johan Teleman
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+package ms.numpress;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.DoubleBuffer;
+import java.util.Arrays;
+import java.util.Random;
+
+/**
+ * Compares decoding with MSNumpress on arrays against NativeMSNumpress on
+ * direct buffers, in the manner of a JMH average time benchmark: warmup 
+ * iterations, then measured iterations of a fixed duration, reporting the 
+ * mean and spread of ns per decoded array. Unlike JMH, all iterations run
+ * in this one JVM, without forks, so profile pollution between the two 
+ * decoders is not ruled out. Run (after mvn test-compile)
+ * with the native library on java.library.path, e.g.
+ *
+ * 		java -Djava.library.path=src/main/cpp -cp target/classes:target/test-classes \
+ * 			ms.numpress.NativeMSNumpressBenchmark
+ *
+ * This is not a junit test, so it is not run by mvn test.
+ */
+public class NativeMSNumpressBenchmark {
+
+	static final int N 				= 10000;
+	static final int WARMUP 		= 5;
+	static final int ITERATIONS 	= 10;
+	static final long ITERATION_NS 	= 200000000L;
+
+	static double sink;
+
+	interface Decode {
+		void run();
+	}
+
+	public static void main(String[] args) {
+		Random random = new Random(123459);
+		double[] mzs = new double[N];
+		double[] ics = new double[N];
+		mzs[0] = 300 + random.nextDouble();
+		for (int i=0; i<N; i++) {
+			if (i > 0) mzs[i] = mzs[i-1] + random.nextDouble();
+			ics[i] = Math.pow(10, 6 * random.nextDouble());
+		}
+
+		System.out.println("native library available: " + NativeMSNumpress.isAvailable());
+		System.out.println(String.format("%-10s %-8s %14s %10s", "codec", "path", "ns/array", "+-"));
+
+		byte[] encoded = new byte[N * 5 + 8];
+		int size;
+
+		size = MSNumpress.encodeLinear(mzs, N, encoded, MSNumpress.optimalLinearFixedPoint(mzs, N));
+		compare("linear", NativeMSNumpress.LINEAR, encoded, size);
+
+		size = MSNumpress.encodePic(ics, N, encoded);
+		compare("pic", NativeMSNumpress.PIC, encoded, size);
+
+		size = MSNumpress.encodeSlof(ics, N, encoded, MSNumpress.optimalSlofFixedPoint(ics, N));
+		compare("slof", NativeMSNumpress.SLOF, encoded, size);
+	}
+
+
+	static void compare(
+			String name,
+			final int codec,
+			byte[] encoded,
+			final int size
+	) {
+		final byte[] bytes = Arrays.copyOf(encoded, size);
+		final double[] values = new double[NativeMSNumpress.decodeBound(codec, size)];
+		final ByteBuffer directBytes = ByteBuffer.allocateDirect(size);
+		directBytes.put(bytes).flip();
+		final DoubleBuffer directValues = ByteBuffer.allocateDirect(values.length * 8)
+				.order(ByteOrder.nativeOrder()).asDoubleBuffer();
+
+		report(name, "java", measure(new Decode() {
+			public void run() {
+				int n;
+				if (codec == NativeMSNumpress.LINEAR) 	n = MSNumpress.decodeLinear(bytes, size, values);
+				else if (codec == NativeMSNumpress.PIC) n = MSNumpress.decodePic(bytes, size, values);
+				else 									n = MSNumpress.decodeSlof(bytes, size, values);
+				sink += values[n - 1];
+			}
+		}));
+
+		report(name, "buffers", measure(new Decode() {
+			public void run() {
+				directBytes.rewind();
+				directValues.clear();
+				int n = NativeMSNumpress.decode(codec, directBytes, directValues);
+				sink += directValues.get(n - 1);
+			}
+		}));
+	}
+
+
+	/**
+	 * ns per run of every measured iteration, after the warmup iterations.
+	 */
+	static double[] measure(Decode decode) {
+		double[] nsPerRun = new double[ITERATIONS];
+		for (int it=-WARMUP; it<ITERATIONS; it++) {
+			long runs = 0;
+			long start = System.nanoTime();
+			long now;
+			do {
+				decode.run();
+				runs++;
+			} while ((now = System.nanoTime()) - start < ITERATION_NS);
+			if (it >= 0)
+				nsPerRun[it] = (now - start) / (double)runs;
+		}
+		return nsPerRun;
+	}
+
+
+	static void report(String codec, String path, double[] nsPerRun) {
+		double mean = 0, var = 0;
+		for (double x : nsPerRun) mean += x;
+		mean /= nsPerRun.length;
+		for (double x : nsPerRun) var += (x - mean) * (x - mean);
+		double sd = Math.sqrt(var / (nsPerRun.length - 1));
+		System.out.println(String.format("%-10s %-8s %14.0f %10.0f", codec, path, mean, sd));
+	}
+}